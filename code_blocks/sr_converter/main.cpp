@@ -1,6 +1,17 @@
 #include <iostream>
 #include "sample_rate_converter.hpp"
 #include <fstream>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <dirent.h>
+#include <sys/stat.h>
 
 enum VariableType {
     SET_8BIT = 0,
@@ -23,7 +34,8 @@ bool check_type(int type);
 bool check_accuracy(int accuracy);
 bool check_interpolation(int interpolation);
 bool check_oversampling(int oversampling);
-bool check_mul(int mul);
+bool check_mul(int mul, bool is_direct = false);
+bool check_threads(int threads);
 
 // функция для открытия файла
 template <typename T>
@@ -76,47 +88,494 @@ bool calc_src_fir(
         int freq_in,
         int freq_out,
         int oversampling,
-        unsigned char mul) {
-    SrcFir<T1> iSrc(freq_in, freq_out, oversampling, mul);
+        int mul,
+        bool is_min_phase,
+        bool is_dither,
+        unsigned int seed,
+        std::string table_file_name) {
     std::vector<T1> in, out;
     if(!open_file(input_file_name, in)) return false;
-    int res = iSrc.process(in, out);
+    int res = 0;
+    double latency = 0.0;
+    // для длинных фильтров блочная фильтрация через БПФ быстрее
+    if(!is_min_phase && SrcFirFft<T1>::is_faster(freq_in, freq_out, mul)) {
+        std::cout << "engine: fft overlap-save" << std::endl;
+        if(table_file_name.size() > 0)
+            std::cout << "warning: -table is not used by the fft engine" << std::endl;
+        SrcFirFft<T1> iSrc;
+        if(!iSrc.init(freq_in, freq_out, oversampling, mul)) {
+            std::cout << "error: unsupported filter parameters" << std::endl;
+            return false;
+        }
+        iSrc.set_dither(is_dither, seed);
+        res = iSrc.process(in, out);
+        res += iSrc.flush(out);
+        latency = iSrc.latency_out();
+    } else {
+        // прямая фильтрация поддерживает не более 255 умножений
+        if(!check_mul(mul, true)) return false;
+        SrcFir<T1> iSrc;
+        bool is_init = table_file_name.size() > 0 ?
+            iSrc.init(freq_in, freq_out, oversampling, mul, is_min_phase, table_file_name) :
+            iSrc.init(freq_in, freq_out, oversampling, mul, is_min_phase);
+        if(!is_init) {
+            std::cout << "error: unsupported filter parameters" << std::endl;
+            return false;
+        }
+        iSrc.set_dither(is_dither, seed);
+        res = iSrc.process(in, out);
+        res += iSrc.flush(out);
+        latency = iSrc.latency_out();
+    }
     if(!save_file(output_file_name, out)) return false;
     std::cout << "data saved to file: " << output_file_name << std::endl;
     std::cout << "input data length: " << in.size() << std::endl;
     std::cout << "output data length: " << res << std::endl;
+    std::cout << "latency (output samples): " << latency << std::endl;
     return true;
 }
 
 // функция для обработки файлов методом Linear и Lagrange
-template <typename T1, template<typename> class T2>
+template <typename T1, template<typename, typename> class T2>
 bool calc_src_linear_and_lagrange(
         std::string input_file_name,
         std::string output_file_name,
         int freq_in,
         int freq_out,
-        int param) {
-    T2<T1> iSrc(freq_in, freq_out, param);
+        int param,
+        bool is_dither,
+        unsigned int seed) {
+    T2<T1, T1> iSrc(freq_in, freq_out, param);
+    iSrc.set_dither(is_dither, seed);
     std::vector<T1> in, out;
     if(!open_file(input_file_name, in)) return false;
     int res = iSrc.process(in, out);
+    res += iSrc.flush(out);
     if(!save_file(output_file_name, out)) return false;
     std::cout << "data saved to file: " << output_file_name << std::endl;
     std::cout << "input data length: " << in.size() << std::endl;
     std::cout << "output data length: " << res << std::endl;
+    std::cout << "latency (output samples): " << iSrc.latency_out() << std::endl;
     return true;
 }
 
+// параметры пакетной и конвейерной обработки
+struct SrcParam {
+    bool is_batch;
+    std::vector<std::string> files;
+    std::string output_dir;
+    std::string input_file_name;
+    std::string output_file_name;
+    int threads;
+    int type;
+    int freq_in;
+    int freq_out;
+    int accuracy;
+    int interpolation;
+    int oversampling;
+    int mul;
+    bool is_min_phase;
+    bool is_dither;
+    unsigned int seed;
+    std::string table_file_name;
+};
+
+// статистика пакетной обработки
+struct BatchStat {
+    std::atomic<long long> files;
+    std::atomic<long long> errors;
+    std::atomic<long long> input_samples;
+    std::atomic<long long> output_samples;
+    BatchStat() : files(0), errors(0), input_samples(0), output_samples(0) {}
+};
+
+// очереди задач с перехватом работы (work-stealing):
+// каждый поток берёт задачи с конца своей очереди,
+// а когда она пуста - с начала очередей других потоков
+class WorkStealingQueue {
+private:
+    std::vector<std::deque<size_t>> m_queues;
+    std::vector<std::mutex> m_mutex;
+public:
+    WorkStealingQueue(size_t workers, size_t tasks) :
+            m_queues(workers), m_mutex(workers) {
+        for(size_t i = 0; i < tasks; ++i)
+            m_queues[i % workers].push_back(i);
+    }
+
+    bool pop(size_t worker, size_t &task) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex[worker]);
+            if(!m_queues[worker].empty()) {
+                task = m_queues[worker].back();
+                m_queues[worker].pop_back();
+                return true;
+            }
+        }
+        for(size_t i = 1; i < m_queues.size(); ++i) {
+            size_t victim = (worker + i) % m_queues.size();
+            std::lock_guard<std::mutex> lock(m_mutex[victim]);
+            if(!m_queues[victim].empty()) {
+                task = m_queues[victim].front();
+                m_queues[victim].pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// получить имя файла без каталога
+std::string get_file_name(const std::string &path) {
+    size_t pos = path.find_last_of("/\\");
+    if(pos == std::string::npos) return path;
+    return path.substr(pos + 1);
+}
+
+// получить список файлов из каталога или из файла со списком
+bool get_file_list(std::string path, std::vector<std::string> &files) {
+    DIR *dir = opendir(path.c_str());
+    if(dir != NULL) {
+        struct dirent *entry;
+        while((entry = readdir(dir)) != NULL) {
+            std::string file_name = path + "/" + entry->d_name;
+            struct stat file_stat;
+            if(stat(file_name.c_str(), &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+                files.push_back(file_name);
+        }
+        closedir(dir);
+        std::sort(files.begin(), files.end());
+        return true;
+    }
+    std::ifstream file(path);
+    if(!file.is_open()) {
+        std::cout << "error: can not open file list: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.size() > 0 && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if(line.size() > 0)
+            files.push_back(line);
+    }
+    return true;
+}
+
+// получить начальное значение генератора дизеринга для файла (FNV-1a от имени),
+// чтобы результат не зависел от порядка обработки файлов потоками
+unsigned int get_file_seed(unsigned int seed, const std::string &path) {
+    std::string file_name = get_file_name(path);
+    unsigned int hash = 2166136261U;
+    for(size_t i = 0; i < file_name.size(); ++i) {
+        hash ^= (unsigned char)file_name[i];
+        hash *= 16777619U;
+    }
+    return seed ^ hash;
+}
+
+// поток пакетной обработки, преобразователь и буферы
+// сохраняются между файлами
+template <typename T1, class T2>
+void batch_worker(
+        size_t id,
+        WorkStealingQueue &queue,
+        const SrcParam &param,
+        const T2 &prototype,
+        BatchStat &stat) {
+    T2 iSrc(prototype);
+    std::vector<T1> in, out;
+    size_t task;
+    while(queue.pop(id, task)) {
+        in.clear();
+        out.clear();
+        const std::string &input_file_name = param.files[task];
+        if(!open_file(input_file_name, in)) {
+            stat.errors++;
+            continue;
+        }
+        iSrc.set_dither(param.is_dither, get_file_seed(param.seed, input_file_name));
+        iSrc.process(in, out);
+        iSrc.flush(out);
+        if(!save_file(param.output_dir + "/" + get_file_name(input_file_name), out)) {
+            stat.errors++;
+            continue;
+        }
+        stat.files++;
+        stat.input_samples += in.size();
+        stat.output_samples += out.size();
+    }
+}
+
+// запустить пакетную обработку на пуле потоков
+template <typename T1, class T2>
+bool run_batch(const SrcParam &param, const T2 &prototype) {
+    size_t threads = (std::min)((size_t)param.threads, param.files.size());
+    if(threads == 0) threads = 1;
+    WorkStealingQueue queue(threads, param.files.size());
+    BatchStat stat;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for(size_t i = 0; i < threads; ++i)
+        pool.push_back(std::thread(batch_worker<T1, T2>, i, std::ref(queue),
+            std::cref(param), std::cref(prototype), std::ref(stat)));
+    for(size_t i = 0; i < pool.size(); ++i)
+        pool[i].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(seconds <= 0.0) seconds = 1e-9;
+    std::cout << "threads: " << threads << std::endl;
+    std::cout << "files converted: " << stat.files << std::endl;
+    std::cout << "files failed: " << stat.errors << std::endl;
+    std::cout << "time: " << seconds << " s" << std::endl;
+    std::cout << "files/s: " << (double)stat.files / seconds << std::endl;
+    std::cout << "input samples/s: " << (double)stat.input_samples / seconds << std::endl;
+    std::cout << "output samples/s: " << (double)stat.output_samples / seconds << std::endl;
+    return stat.errors == 0;
+}
+
+// ограниченная очередь между стадиями конвейера
+template <typename T>
+class BoundedQueue {
+private:
+    std::deque<T> m_queue;
+    size_t m_capacity;
+    bool m_is_closed;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+public:
+    BoundedQueue(size_t capacity) : m_capacity(capacity), m_is_closed(false) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_queue.size() >= m_capacity)
+            m_not_full.wait(lock);
+        m_queue.push_back(item);
+        m_not_empty.notify_one();
+    }
+
+    // возвращает false, если очередь закрыта и пуста
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_queue.empty() && !m_is_closed)
+            m_not_empty.wait(lock);
+        if(m_queue.empty())
+            return false;
+        item = m_queue.front();
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_closed = true;
+        m_not_empty.notify_all();
+    }
+};
+
+// время работы стадии конвейера без учёта ожидания в очередях
+class StageTimer {
+private:
+    std::chrono::steady_clock::time_point m_start;
+    double m_busy;
+public:
+    StageTimer() : m_busy(0.0) {}
+    void start() {
+        m_start = std::chrono::steady_clock::now();
+    }
+    void stop() {
+        m_busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+    double get_busy() const {
+        return m_busy;
+    }
+};
+
+// запустить конвейерную обработку файла: чтение и разбор, преобразование,
+// форматирование и запись выполняются в отдельных потоках, связанных
+// ограниченными очередями буферов, которые используются повторно
+template <typename T1, class T2>
+bool run_pipeline(const SrcParam &param, T2 &iSrc) {
+    const size_t BUFFER_SIZE = 16384;   // сэмплов во входном буфере
+    const size_t BUFFER_COUNT = 4;      // буферов на каждое соединение стадий
+
+    std::ifstream input_file(param.input_file_name);
+    if(!input_file.is_open()) {
+        std::cout << "error: can not open file: " << param.input_file_name << std::endl;
+        return false;
+    }
+    std::ofstream output_file(param.output_file_name);
+    if(!output_file.is_open()) {
+        std::cout << "error: can not open file: " << param.output_file_name << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<T1>> in_buffers(BUFFER_COUNT), out_buffers(BUFFER_COUNT);
+    BoundedQueue<std::vector<T1>*> in_free(BUFFER_COUNT), in_full(BUFFER_COUNT);
+    BoundedQueue<std::vector<T1>*> out_free(BUFFER_COUNT), out_full(BUFFER_COUNT);
+    for(size_t i = 0; i < BUFFER_COUNT; ++i) {
+        in_buffers[i].reserve(BUFFER_SIZE);
+        in_free.push(&in_buffers[i]);
+        out_free.push(&out_buffers[i]);
+    }
+    StageTimer read_timer, process_timer, write_timer;
+    long long input_samples = 0, output_samples = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // чтение и разбор
+    std::thread reader([&]() {
+        std::vector<T1> *buffer;
+        bool is_end = false;
+        while(!is_end && in_free.pop(buffer)) {
+            read_timer.start();
+            buffer->clear();
+            std::string word;
+            while(buffer->size() < BUFFER_SIZE) {
+                if(!(input_file >> word)) {
+                    is_end = true;
+                    break;
+                }
+                if(std::is_same<T1, float>::value || std::is_same<T1, double>::value) {
+                    buffer->push_back(std::atof(word.c_str()));
+                } else {
+                    buffer->push_back(std::atoi(word.c_str()));
+                }
+            }
+            input_samples += buffer->size();
+            read_timer.stop();
+            in_full.push(buffer);
+        }
+        in_full.close();
+    });
+
+    // преобразование частоты дискретизации
+    std::thread resampler([&]() {
+        std::vector<T1> *in, *out;
+        while(in_full.pop(in)) {
+            out_free.pop(out);
+            process_timer.start();
+            out->clear();
+            iSrc.process(*in, *out);
+            process_timer.stop();
+            in_free.push(in);
+            out_full.push(out);
+        }
+        out_free.pop(out);
+        process_timer.start();
+        out->clear();
+        iSrc.flush(*out);
+        process_timer.stop();
+        out_full.push(out);
+        out_full.close();
+    });
+
+    // форматирование и запись
+    std::thread writer([&]() {
+        std::vector<T1> *buffer;
+        std::string text;
+        while(out_full.pop(buffer)) {
+            write_timer.start();
+            text.clear();
+            for(size_t n = 0; n < buffer->size(); ++n) {
+                text += std::to_string((*buffer)[n]);
+                text += '\n';
+            }
+            output_file.write(text.data(), text.size());
+            output_samples += buffer->size();
+            write_timer.stop();
+            out_free.push(buffer);
+        }
+    });
+
+    reader.join();
+    resampler.join();
+    writer.join();
+    output_file.close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(seconds <= 0.0) seconds = 1e-9;
+    std::cout << "data saved to file: " << param.output_file_name << std::endl;
+    std::cout << "input data length: " << input_samples << std::endl;
+    std::cout << "output data length: " << output_samples << std::endl;
+    std::cout << "time: " << seconds << " s" << std::endl;
+    std::cout << "input samples/s: " << (double)input_samples / seconds << std::endl;
+    std::cout << "stage utilization:" << std::endl;
+    std::cout << "read and parse: " << 100.0 * read_timer.get_busy() / seconds << " %" << std::endl;
+    std::cout << "resample: " << 100.0 * process_timer.get_busy() / seconds << " %" << std::endl;
+    std::cout << "format and write: " << 100.0 * write_timer.get_busy() / seconds << " %" << std::endl;
+    if(output_samples == 0) {
+        std::cout << "error: no data" << std::endl;
+        return false;
+    }
+    return !output_file.fail();
+}
+
+// запустить пакетную или конвейерную обработку
+template <typename T1, class T2>
+bool run_src(const SrcParam &param, T2 &iSrc) {
+    if(param.is_batch)
+        return run_batch<T1>(param, iSrc);
+    return run_pipeline<T1>(param, iSrc);
+}
+
+// функция для пакетной и конвейерной обработки файлов любым методом
+template <typename T1>
+bool calc_src(const SrcParam &param) {
+    if(param.type == SET_LINEAR) {
+        SrcLinear<T1> iSrc(param.freq_in, param.freq_out, param.accuracy);
+        iSrc.set_dither(param.is_dither, param.seed);
+        return run_src<T1>(param, iSrc);
+    } else
+    if(param.type == SET_LAGRANGE) {
+        SrcLagrange<T1> iSrc(param.freq_in, param.freq_out, param.interpolation);
+        iSrc.set_dither(param.is_dither, param.seed);
+        return run_src<T1>(param, iSrc);
+    }
+    if(!param.is_min_phase && SrcFirFft<T1>::is_faster(param.freq_in, param.freq_out, param.mul)) {
+        std::cout << "engine: fft overlap-save" << std::endl;
+        if(param.table_file_name.size() > 0)
+            std::cout << "warning: -table is not used by the fft engine" << std::endl;
+        SrcFirFft<T1> iSrc;
+        if(!iSrc.init(param.freq_in, param.freq_out, param.oversampling, param.mul)) {
+            std::cout << "error: unsupported filter parameters" << std::endl;
+            return false;
+        }
+        iSrc.set_dither(param.is_dither, param.seed);
+        return run_src<T1>(param, iSrc);
+    }
+    if(!check_mul(param.mul, true)) return false;
+    SrcFir<T1> iSrc;
+    bool is_init = param.table_file_name.size() > 0 ?
+        iSrc.init(param.freq_in, param.freq_out, param.oversampling, param.mul, param.is_min_phase, param.table_file_name) :
+        iSrc.init(param.freq_in, param.freq_out, param.oversampling, param.mul, param.is_min_phase);
+    if(!is_init) {
+        std::cout << "error: unsupported filter parameters" << std::endl;
+        return false;
+    }
+    iSrc.set_dither(param.is_dither, param.seed);
+    return run_src<T1>(param, iSrc);
+}
+
 int main(int argc, char* argv[]) {
     if(argc == 0)
         return 0;
 
     std::string input_file_name, output_file_name;
+    std::string batch_path;         // каталог или файл со списком файлов для пакетной обработки
+    bool is_pipeline = false;       // конвейерная обработка в отдельных потоках
+    int threads = std::thread::hardware_concurrency();
+    if(threads <= 0) threads = 1;
     int freq_in = 0, freq_out = 0, type = SET_LINEAR, accuracy = 16;
     int variable_type = SET_16BIT;  // тип переменной
     int interpolation = 3;          // интерполяция для метода Lagrange
     int oversampling = 1024;        // частота дискретизации фильтра, определяет точность по оси времени.
     int mul = 1;                    // желаемое число умножений при фильтрации, определяет загрузку процессора
+    bool is_min_phase = false;      // фильтр с минимальной фазой для метода FIR
+    bool is_dither = false;         // TPDF дизеринг для целых типов
+    unsigned int seed = SrcSampleFormat<short, short>::DEFAULT_SEED; // начальное значение генератора дизеринга
+    std::string table_file_name;    // файл с таблицей коэффициентов для метода FIR
 
     for(int i = 0; i < argc; i++) {
         std::string input_arg(argv[i]);
@@ -149,9 +608,15 @@ int main(int argc, char* argv[]) {
             std::cout << "-interp <number>      - interpolation order for conversion type 'Lagrange'" << std::endl;
             std::cout << "-i <number>           - interpolation order for conversion type 'Lagrange'" << std::endl;
             std::cout << std::endl;
+            std::cout << "-batch <path>         - convert all files of a directory or a file list,\n -out sets the output directory" << std::endl;
+            std::cout << "-threads <number>     - number of threads for batch mode (default: number of cores)" << std::endl;
+            std::cout << "-pipeline             - read, resample and write the file in separate threads" << std::endl;
+            std::cout << std::endl;
             std::cout << "-fir                  - conversion type 'FIR'" << std::endl;
             std::cout << "-r <number>           - FIR sampling rate,\n determines the accuracy along the time axis" << std::endl;
             std::cout << "-m <number>           - the desired number of multiplications when filtering\n determines the CPU load (for FIR)" << std::endl;
+            std::cout << "-minphase             - use minimum-phase filter with low latency (for FIR)" << std::endl;
+            std::cout << "-table <file name>    - load the filter table from the file or save it there (for FIR)" << std::endl;
             std::cout << std::endl;
             std::cout << "-int32                - use integer type (int32)" << std::endl;
             std::cout << "-i32                  - use integer type (int32)" << std::endl;
@@ -163,6 +628,8 @@ int main(int argc, char* argv[]) {
             std::cout << "-f                    - use floating point type (float)" << std::endl;
             std::cout << "-double               - use floating point type (double)" << std::endl;
             std::cout << "-d                    - use floating point type (double)" << std::endl;
+            std::cout << "-dither               - add TPDF dither before rounding (for integer types)" << std::endl;
+            std::cout << "-seed <number>        - dither generator seed, in batch mode combined with the file name" << std::endl;
             std::cout << std::endl;
             if(argc == 1)
                 return 0;
@@ -176,6 +643,18 @@ int main(int argc, char* argv[]) {
             if(!check_arg_size(i, argc)) return 0;
             output_file_name = std::string(argv[i + 1]);
         } else
+        if(input_arg == "-batch") {
+            if(!check_arg_size(i, argc)) return 0;
+            batch_path = std::string(argv[i + 1]);
+        } else
+        if(input_arg == "-pipeline") {
+            is_pipeline = true;
+        } else
+        if(input_arg == "-threads") {
+            if(!check_arg_size(i, argc)) return 0;
+            threads = atoi(argv[i + 1]);
+            if(!check_threads(threads)) return 0;
+        } else
 
         if(input_arg == "-fi") {
             if(!check_arg_size(i, argc)) return 0;
@@ -218,11 +697,25 @@ int main(int argc, char* argv[]) {
             oversampling = atoi(argv[i + 1]);
             if(!check_oversampling(oversampling)) return 0;
         } else
-        if(input_arg == "-mul" || input_arg == "-mul") {
+        if(input_arg == "-mul" || input_arg == "-m") {
             if(!check_arg_size(i, argc)) return 0;
             mul = atoi(argv[i + 1]);
             if(!check_mul(mul)) return 0;
         } else
+        if(input_arg == "-minphase") {
+            is_min_phase = true;
+        } else
+        if(input_arg == "-table") {
+            if(!check_arg_size(i, argc)) return 0;
+            table_file_name = std::string(argv[i + 1]);
+        } else
+        if(input_arg == "-dither") {
+            is_dither = true;
+        } else
+        if(input_arg == "-seed") {
+            if(!check_arg_size(i, argc)) return 0;
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else
 
         if(input_arg == "-int32" || input_arg == "-i32") {
             variable_type = SET_32BIT;
@@ -245,7 +738,7 @@ int main(int argc, char* argv[]) {
         std::cout << "error: no sampling rate specified in parameters" << std::endl;
         return 0;
     }
-    if(input_file_name.size() == 0 || output_file_name.size() == 0) {
+    if((input_file_name.size() == 0 && batch_path.size() == 0) || output_file_name.size() == 0) {
         std::cout << "error: no files specified in parameters" << std::endl;
         return 0;
     }
@@ -261,6 +754,7 @@ int main(int argc, char* argv[]) {
     } else
     if(type == SET_FIR) {
         std::cout << "fir" << std::endl << "oversampling: " << oversampling << std::endl << "mul: " << mul << std::endl;
+        if(is_min_phase) std::cout << "minimum phase" << std::endl;
     }
 
     if(variable_type == SET_8BIT) {
@@ -281,57 +775,101 @@ int main(int argc, char* argv[]) {
     std::cout << std::endl;
 
     bool state = true;
+    if(batch_path.size() > 0 || is_pipeline) {
+        SrcParam param;
+        param.is_batch = batch_path.size() > 0;
+        if(param.is_batch) {
+            if(!get_file_list(batch_path, param.files)) return 0;
+            std::cout << "batch: " << param.files.size() << " files" << std::endl;
+        } else {
+            std::cout << "pipeline: read, resample and write in separate threads" << std::endl;
+        }
+        param.output_dir = output_file_name;
+        param.input_file_name = input_file_name;
+        param.output_file_name = output_file_name;
+        param.threads = threads;
+        param.type = type;
+        param.freq_in = freq_in;
+        param.freq_out = freq_out;
+        param.accuracy = accuracy;
+        param.interpolation = interpolation;
+        param.oversampling = oversampling;
+        param.mul = mul;
+        param.is_min_phase = is_min_phase;
+        param.is_dither = is_dither;
+        param.seed = seed;
+        param.table_file_name = table_file_name;
+        if(variable_type == SET_8BIT) {
+            state = calc_src<char>(param);
+        } else
+        if(variable_type == SET_16BIT) {
+            state = calc_src<short>(param);
+        } else
+        if(variable_type == SET_32BIT) {
+            state = calc_src<long>(param);
+        } else
+        if(variable_type == SET_FLOAT) {
+            state = calc_src<float>(param);
+        } else
+        if(variable_type == SET_DOUBLE) {
+            state = calc_src<double>(param);
+        }
+        if(!state)
+            return 0;
+        std::cout << "conversion completed!" << std::endl;
+        return 0;
+    }
     // начнем преобразование
     if(type == SET_LINEAR) {
 
         if(variable_type == SET_8BIT) {
-            state = calc_src_linear_and_lagrange<char, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy);
+            state = calc_src_linear_and_lagrange<char, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy, is_dither, seed);
         } else
         if(variable_type == SET_16BIT) {
-            state = calc_src_linear_and_lagrange<short, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy);
+            state = calc_src_linear_and_lagrange<short, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy, is_dither, seed);
         } else
         if(variable_type == SET_32BIT) {
-            state = calc_src_linear_and_lagrange<long, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy);
+            state = calc_src_linear_and_lagrange<long, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy, is_dither, seed);
         } else
         if(variable_type == SET_FLOAT) {
-            state = calc_src_linear_and_lagrange<float, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy);
+            state = calc_src_linear_and_lagrange<float, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy, is_dither, seed);
         } else
         if(variable_type == SET_DOUBLE) {
-            state = calc_src_linear_and_lagrange<double, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy);
+            state = calc_src_linear_and_lagrange<double, SrcLinear>(input_file_name, output_file_name, freq_in, freq_out, accuracy, is_dither, seed);
         }
     } else
     if(type == SET_LAGRANGE) {
         if(variable_type == SET_8BIT) {
-            state = calc_src_linear_and_lagrange<char, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation);
+            state = calc_src_linear_and_lagrange<char, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation, is_dither, seed);
         } else
         if(variable_type == SET_16BIT) {
-            state = calc_src_linear_and_lagrange<short, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation);
+            state = calc_src_linear_and_lagrange<short, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation, is_dither, seed);
         } else
         if(variable_type == SET_32BIT) {
-            state = calc_src_linear_and_lagrange<long, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation);
+            state = calc_src_linear_and_lagrange<long, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation, is_dither, seed);
         } else
         if(variable_type == SET_FLOAT) {
-            state = calc_src_linear_and_lagrange<float, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation);
+            state = calc_src_linear_and_lagrange<float, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation, is_dither, seed);
         } else
         if(variable_type == SET_DOUBLE) {
-            state = calc_src_linear_and_lagrange<double, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation);
+            state = calc_src_linear_and_lagrange<double, SrcLagrange>(input_file_name, output_file_name, freq_in, freq_out, interpolation, is_dither, seed);
         }
     }
     if(type == SET_FIR) {
         if(variable_type == SET_8BIT) {
-            state = calc_src_fir<char>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul);
+            state = calc_src_fir<char>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul, is_min_phase, is_dither, seed, table_file_name);
         } else
         if(variable_type == SET_16BIT) {
-            state = calc_src_fir<short>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul);
+            state = calc_src_fir<short>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul, is_min_phase, is_dither, seed, table_file_name);
         } else
         if(variable_type == SET_32BIT) {
-            state = calc_src_fir<long>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul);
+            state = calc_src_fir<long>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul, is_min_phase, is_dither, seed, table_file_name);
         } else
         if(variable_type == SET_FLOAT) {
-            state = calc_src_fir<float>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul);
+            state = calc_src_fir<float>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul, is_min_phase, is_dither, seed, table_file_name);
         } else
         if(variable_type == SET_DOUBLE) {
-            state = calc_src_fir<double>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul);
+            state = calc_src_fir<double>(input_file_name, output_file_name, freq_in, freq_out, oversampling, mul, is_min_phase, is_dither, seed, table_file_name);
         }
     }
     if(!state)
@@ -388,12 +926,18 @@ bool check_oversampling(int oversampling) {
     return true;
 }
 
-bool check_mul(int mul) {
-    if(mul < 0) {
+bool check_mul(int mul, bool is_direct) {
+    if(mul <= 0 || (is_direct && mul > (std::numeric_limits<unsigned char>::max)())) {
         std::cout << "error: incorrect mul" << std::endl;
         return false;
     }
     return true;
 }
 
-
+bool check_threads(int threads) {
+    if(threads <= 0) {
+        std::cout << "error: incorrect number of threads" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -4,14 +4,148 @@
 #include <vector>
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <string>
+#include <memory>
+#include <map>
+#include <deque>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// windows.h нужен для SrcMappedFile. Чтобы макросы min и max и лишние
+// заголовки не попадали в код, подключающий этот файл, windows.h
+// подключается с NOMINMAX и WIN32_LEAN_AND_MEAN, которые затем удаляются,
+// если были определены здесь. Если windows.h уже подключён с макросами
+// min и max, они не мешают этому файлу: везде используются
+// (std::min), (std::max) и (std::numeric_limits<T>::max)().
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#define SRC_UNDEF_NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define SRC_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#ifdef SRC_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef SRC_UNDEF_NOMINMAX
+#endif
+#ifdef SRC_UNDEF_WIN32_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef SRC_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** \brief Преобразование формата сэмплов
+ * Переводит значение сигнала из шкалы входного типа в шкалу выходного,
+ * при необходимости добавляет треугольный (TPDF) дизеринг амплитудой
+ * в 1 младший разряд, округляет и ограничивает амплитуду.
+ * Полная шкала целого типа равна max() + 1, типа с плавающей точкой - 1.0,
+ * поэтому short 16384 соответствует float 0.5.
+ * Используется преобразователями внутри цикла вычисления выходных сэмплов,
+ * чтобы каждый сэмпл записывался только один раз.
+ * Генератор дизеринга начинает с заданного начального значения после
+ * set_dither() и reset(), поэтому результат повторяется от запуска к запуску,
+ * а разные начальные значения дают некоррелированный дизеринг.
+ */
+template <typename TIn, typename TOut>
+class SrcSampleFormat {
+private:
+    double m_scale;
+    bool m_is_dither;
+    unsigned int m_dither_seed;
+    unsigned int m_seed;
+
+    /** \brief Генератор псевдослучайных чисел xorshift32
+     * \return равномерно распределённое число в диапазоне [0, 1)
+     */
+    inline double get_random() {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (double)m_seed * (1.0 / 4294967296.0);
+    }
+
+public:
+    static const unsigned int DEFAULT_SEED = 2463534242U;
+
+    SrcSampleFormat() : m_is_dither(false), m_dither_seed(DEFAULT_SEED), m_seed(DEFAULT_SEED) {
+        m_scale = get_full_scale<TOut>() / get_full_scale<TIn>();
+    }
+
+    /** \brief Получить значение полной шкалы типа
+     * \return max() + 1 для целых типов, 1.0 для типов с плавающей точкой
+     */
+    template <typename T>
+    static double get_full_scale() {
+        if(std::is_floating_point<T>::value) return 1.0;
+        return (double)(std::numeric_limits<T>::max)() + 1.0;
+    }
+
+    /** \brief Включить или выключить дизеринг
+     * Дизеринг применяется только для целого выходного типа.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора, 0 заменяется на DEFAULT_SEED
+     */
+    void set_dither(bool is_dither, unsigned int seed = DEFAULT_SEED) {
+        m_is_dither = is_dither && !std::is_floating_point<TOut>::value;
+        m_dither_seed = seed != 0 ? seed : DEFAULT_SEED;
+        reset();
+    }
+
+    /** \brief Вернуть генератор дизеринга к начальному значению
+     */
+    void reset() {
+        m_seed = m_dither_seed;
+    }
+
+    /** \brief Преобразовать значение сигнала
+     * \param value значение в шкале входного типа, вычисления ведутся в типе V
+     * \return значение выходного типа
+     */
+    template <typename V>
+    inline TOut convert(V value) {
+        value *= (V)m_scale;
+        if(!std::is_floating_point<TOut>::value) {
+            if(m_is_dither) value += (V)(get_random() - get_random());
+            value = std::floor(value + (V)0.5);
+        }
+
+        // ограничение амплитуды
+        if(value >= (V)(std::numeric_limits<TOut>::max)())
+            return (std::numeric_limits<TOut>::max)();
+
+        if(value <= (V)std::numeric_limits<TOut>::lowest())
+            return std::numeric_limits<TOut>::lowest();
+
+        return (TOut)value;
+    }
+};
 
 /** \brief Преобразователь частоты дискретизации
  * с линейной интерполяцией.
- * Выходной сигнал имеет задержку на 1 сэмпл
+ * Выходной сигнал не имеет задержки, но для вычисления выходного сэмпла
+ * нужен следующий за ним входной сэмпл (см. flush()).
+ * Для float и double интерполяция выполняется без приведения к целым числам,
+ * блоками, пригодными для векторизации компилятором.
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
  */
-template <typename T>
+template <typename T, typename TOut = T>
 class SrcLinear {
 private:
+    // тип для вычислений с плавающей точкой
+    typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type TCalc;
+
     unsigned char m_accuracy;
     long long m_mask;
     long long m_dTf;
@@ -20,6 +154,100 @@ private:
     long long m_T;
     long long m_inT;
     T m_previous;
+    SrcSampleFormat<T, TOut> m_format;
+
+    /** \brief Преобразовать частоту дискретизации сигнала с плавающей точкой
+     * Сначала для блока выходных сэмплов рассчитываются номера входных сэмплов
+     * и доли между ними в 32-битных целых от начала блока, затем выполняется
+     * выборка и интерполяция во втором цикле без ветвлений и зависимостей
+     * между итерациями. Преобразование формата с ограничением амплитуды
+     * и дизерингом выполняется отдельным проходом и пропускается,
+     * если входной и выходной типы совпадают с типом вычислений.
+     * \param in входной буфер
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int process_float(std::vector<T> &in, std::vector<TOut> &out) {
+        const int BLOCK_SIZE = 256;
+        const long long n = (long long)in.size();
+        if(n == 0) return 0;
+        // положение по оси времени в формате с фиксированной точкой,
+        // отсчитывается от сэмпла m_previous (номер m_inT - 1)
+        const long long base = m_inT - 1;
+        const long long step = (m_dT << m_accuracy) + m_dTf;
+        // init() с недопустимым отношением частот
+        if(step <= 0) return 0;
+        long long pos = ((m_T - base) << m_accuracy) + m_Tf;
+        // для последнего выходного сэмпла нужен следующий за ним входной сэмпл
+        const long long max_pos = (n << m_accuracy) - 1;
+        long long count = pos <= max_pos ? (max_pos - pos) / step + 1 : 0;
+
+        const TCalc scale = (TCalc)1 / (TCalc)(1LL << m_accuracy);
+        // преобразование формата не нужно
+        const bool is_direct = std::is_same<TOut, TCalc>::value && std::is_floating_point<T>::value;
+        // положение внутри блока не должно переполнять int
+        const long long max_rel = 0x7fffffffLL - m_mask;
+        const int block_size = (int)(std::min)((long long)BLOCK_SIZE, max_rel / step + 1);
+        const int step32 = (int)(std::min)(step, max_rel);
+        const int accuracy = m_accuracy;
+        const int mask = (int)m_mask;
+        size_t offset = out.size();
+        out.resize(offset + (size_t)count);
+        TOut *dst = count > 0 ? &out[offset] : NULL;
+        const T *src = &in[0];
+        // локальные массивы не пересекаются с входным и выходным буферами,
+        // что позволяет компилятору векторизовать выборку
+        int index[BLOCK_SIZE];
+        TCalc frac[BLOCK_SIZE];
+        TCalc value[BLOCK_SIZE];
+
+        long long i = 0;
+        // сэмплы между m_previous и первым входным сэмплом
+        for(; i < count && ((pos + i * step) >> m_accuracy) == 0; ++i) {
+            TCalc f = (TCalc)((pos + i * step) & m_mask) * scale;
+            TCalc a = (TCalc)m_previous;
+            dst[i] = m_format.convert(a + f * ((TCalc)src[0] - a));
+        }
+        while(i < count) {
+            int len = (int)(std::min)((long long)block_size, count - i);
+            const long long block_pos = pos + i * step;
+            const int block_index = (int)(block_pos >> m_accuracy) - 1;
+            const int block_rel = (int)(block_pos & m_mask);
+            for(int k = 0; k < len; ++k) {
+                int p = block_rel + k * step32;
+                index[k] = block_index + (p >> accuracy);
+                frac[k] = (TCalc)(p & mask) * scale;
+            }
+            for(int k = 0; k < len; ++k) {
+                TCalc a = (TCalc)src[index[k]];
+                TCalc b = (TCalc)src[index[k] + 1];
+                value[k] = a + frac[k] * (b - a);
+            }
+            TOut *block_dst = dst + i;
+            if(is_direct) {
+                for(int k = 0; k < len; ++k)
+                    block_dst[k] = (TOut)value[k];
+            } else {
+                for(int k = 0; k < len; ++k)
+                    block_dst[k] = m_format.convert(value[k]);
+            }
+            i += len;
+        }
+
+        pos += count * step;
+        m_T = base + (pos >> m_accuracy);
+        m_Tf = pos & m_mask;
+        m_previous = in[n - 1];
+        m_inT += n;
+        if(m_inT < m_T) {
+            m_T = m_T - m_inT;
+            m_inT = 0;
+        } else {
+            m_inT = m_inT - m_T;
+            m_T = 0;
+        }
+        return (int)count;
+    }
 public:
  //
     SrcLinear() {
@@ -37,11 +265,44 @@ public:
         m_dTf = (long long)(quotient & m_mask);
         m_dT = (long long)(quotient >> accuracy);
         m_accuracy = accuracy;
+        reset();
+        return (quotient > 0);
+    }
+
+    /** \brief Включить или выключить TPDF дизеринг выходного сигнала
+     * Имеет смысл только для целого типа выходных сэмплов.
+     * Для независимого дизеринга в разных преобразователях задайте разные seed.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора, восстанавливается в reset()
+     */
+    void set_dither(bool is_dither, unsigned int seed = SrcSampleFormat<T, TOut>::DEFAULT_SEED) {
+        m_format.set_dither(is_dither, seed);
+    }
+
+    /** \brief Сбросить состояние преобразователя без изменения параметров
+     */
+    void reset() {
         m_Tf = 0;
         m_T = 0;
         m_inT = 0;
         m_previous = 0;
-        return (quotient > 0);
+        m_format.reset();
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * Групповая задержка линейной интерполяции равна нулю:
+     * выходной сэмпл с номером k соответствует моменту k * inSampleRate / outSampleRate.
+     * \return задержка в сэмплах входного сигнала
+     */
+    double latency() const {
+        return 0.0;
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \return задержка в сэмплах выходного сигнала
+     */
+    double latency_out() const {
+        return latency() * (double)(1LL << m_accuracy) / (double)((m_dT << m_accuracy) + m_dTf);
     }
 
     /** \brief Инициализация класса
@@ -58,9 +319,12 @@ public:
      * \param out выходной буфер, должен иметь достаточный размер
      * \return количество сэмплов в выходном буфере
      */
-    int process(std::vector<T> &in, std::vector<T> &out) {
+    int process(std::vector<T> &in, std::vector<TOut> &out) {
+        if(std::is_floating_point<T>::value || std::is_floating_point<TOut>::value)
+            return process_float(in, out);
         int outCount = 0;
         int s = 0;
+        if(in.size() == 0) return 0;
         while(true) {
             while(m_inT <= m_T) {
                 m_previous = in[s++];
@@ -77,8 +341,8 @@ public:
                 }
             }
 
-            T temp = (T)((long long)m_previous + (long long)(((long long)m_Tf * (long long)((long long)in[s] - (long long)m_previous)) >> m_accuracy));
-            out.push_back(temp);
+            long long temp = (long long)m_previous + (long long)(((long long)m_Tf * (long long)((long long)in[s] - (long long)m_previous)) >> m_accuracy);
+            out.push_back(m_format.convert((double)temp));
             outCount++;
             //out[outCount++] = (short)((int)m_previous + (int)(((long)m_Tf * (long)((int)in[s] - (int)m_previous)) >> m_accuracy));
             long long t = m_Tf + m_dTf;
@@ -97,14 +361,34 @@ public:
         return outCount;
         */
     }
+
+    /** \brief Выдать оставшиеся сэмплы
+     * Вход дополняется одним нулевым сэмплом, который нужен для интерполяции
+     * последних выходных сэмплов, после чего состояние преобразователя
+     * сбрасывается для нового потока.
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int flush(std::vector<TOut> &out) {
+        std::vector<T> tail(1, (T)0);
+        int outCount = process(tail, out);
+        reset();
+        return outCount;
+    }
 };
 
 /** \brief Преобразователь частоты дискретизации с интерполяцией по Лагранжу.
  * Выходной сигнал имеет задержку на (N+1)/2 сэмпл.
+ * Для float и double интерполяция выполняется блоками выходных сэмплов
+ * по линейному буферу входного сигнала, пригодными для векторизации компилятором.
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
  */
-template <typename T>
+template <typename T, typename TOut = T>
 class SrcLagrange {
 private:
+    // тип для вычислений с плавающей точкой
+    typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type TCalc;
+
     double m_dT;
     double m_T;
     int m_inT;
@@ -113,6 +397,108 @@ private:
     std::vector<double> m_pLI;
     unsigned char m_interpolation;
     unsigned char m_Hinterpolation;
+    std::vector<TCalc> m_history;
+    std::vector<TCalc> m_coef;
+    std::vector<TCalc> m_weight;
+    std::vector<TCalc> m_delay;
+    std::vector<TCalc> m_prod;
+    std::vector<TCalc> m_sum;
+    std::vector<int> m_index;
+    SrcSampleFormat<T, TOut> m_format;
+
+    /** \brief Преобразовать частоту дискретизации сигнала с плавающей точкой
+     * Входной сигнал добавляется в линейный буфер после N+1 последних сэмплов
+     * предыдущего блока, поэтому окно интерполяции не требует кольцевой адресации.
+     * Для блока выходных сэмплов сначала рассчитываются номера входных сэмплов
+     * и дробные задержки, затем коэффициенты Лагранжа через произведения слева
+     * и справа от узла, затем свёртка. Внутренние циклы идут по выходным сэмплам
+     * и не имеют зависимостей между итерациями.
+     * \param in входной буфер
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int process_float(std::vector<T> &in, std::vector<TOut> &out) {
+        const int BLOCK_SIZE = 256;
+        const int length = m_interpolation + 1;
+        const int n = (int)in.size();
+        if(n == 0) return 0;
+
+        m_history.resize(length + n);
+        for(int i = 0; i < n; ++i)
+            m_history[length + i] = (TCalc)in[i];
+        // окно выходного сэмпла с номером входного сэмпла s - это src[s]...src[s + N]
+        const TCalc *src = &m_history[1];
+
+        m_weight.resize(length * BLOCK_SIZE);
+        m_delay.resize(BLOCK_SIZE);
+        m_prod.resize(BLOCK_SIZE);
+        m_sum.resize(BLOCK_SIZE);
+        m_index.resize(BLOCK_SIZE);
+        int *index = &m_index[0];
+        TCalc *delay = &m_delay[0];
+        TCalc *prod = &m_prod[0];
+        TCalc *sum = &m_sum[0];
+
+        int outCount = 0;
+        double t = m_T;
+        while((int)t < n) {
+            // номера входных сэмплов и дробные задержки
+            int len = 0;
+            for(; len < BLOCK_SIZE && (int)t < n; ++len) {
+                index[len] = (int)t;
+                delay[len] = (TCalc)((double)m_Hinterpolation + t - (double)(int)t);
+                t = t + m_dT;
+            }
+
+            // коэффициенты Лагранжа: произведения (D - m) слева от узла k
+            for(int j = 0; j < len; ++j)
+                prod[j] = (TCalc)1;
+            for(int k = 0; k < length; ++k) {
+                TCalc *weight = &m_weight[k * BLOCK_SIZE];
+                const TCalc coef = m_coef[k];
+                const TCalc node = (TCalc)k;
+                for(int j = 0; j < len; ++j) {
+                    weight[j] = coef * prod[j];
+                    prod[j] *= delay[j] - node;
+                }
+            }
+            // и справа от узла k
+            for(int j = 0; j < len; ++j)
+                prod[j] = (TCalc)1;
+            for(int k = length; k-- > 0;) {
+                TCalc *weight = &m_weight[k * BLOCK_SIZE];
+                const TCalc node = (TCalc)k;
+                for(int j = 0; j < len; ++j) {
+                    weight[j] *= prod[j];
+                    prod[j] *= delay[j] - node;
+                }
+            }
+
+            // свёртка окна с коэффициентами
+            for(int j = 0; j < len; ++j)
+                sum[j] = (TCalc)0;
+            for(int k = 0; k < length; ++k) {
+                const TCalc *weight = &m_weight[k * BLOCK_SIZE];
+                const TCalc *window = src + k;
+                for(int j = 0; j < len; ++j)
+                    sum[j] += weight[j] * window[index[j]];
+            }
+
+            // преобразование формата и ограничение амплитуды
+            size_t offset = out.size();
+            out.resize(offset + len);
+            TOut *dst = &out[offset];
+            for(int j = 0; j < len; ++j)
+                dst[j] = m_format.convert(sum[j]);
+            outCount += len;
+        }
+        m_T = t - (double)n;
+
+        // сохраняем N+1 последних сэмплов для следующего блока
+        std::copy(m_history.end() - length, m_history.end(), m_history.begin());
+        m_history.resize(length);
+        return outCount;
+    }
 public:
 
     SrcLagrange() {
@@ -130,11 +516,52 @@ public:
         m_Hinterpolation = (unsigned char)((interpolation - 1) >> 1);
         m_pF.resize(m_interpolation + 1);
         m_pLI.resize(m_interpolation + 1);
-        m_wrPos = m_interpolation;
+        // знаменатели коэффициентов Лагранжа: 1 / prod(k - m), m != k
+        m_coef.resize(m_interpolation + 1);
+        for(int k = 0; k <= m_interpolation; ++k) {
+            double d = 1.0;
+            for(int m = 0; m <= m_interpolation; ++m)
+                if(m != k) d *= (double)(k - m);
+            m_coef[k] = (TCalc)(1.0 / d);
+        }
         m_dT = (double)inSampleRate / (double)outSampleRate;
+        reset();
+        return (m_dT > 0.0);
+    }
+
+    /** \brief Включить или выключить TPDF дизеринг выходного сигнала
+     * Имеет смысл только для целого типа выходных сэмплов.
+     * Для независимого дизеринга в разных преобразователях задайте разные seed.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора, восстанавливается в reset()
+     */
+    void set_dither(bool is_dither, unsigned int seed = SrcSampleFormat<T, TOut>::DEFAULT_SEED) {
+        m_format.set_dither(is_dither, seed);
+    }
+
+    /** \brief Сбросить состояние преобразователя без изменения параметров
+     */
+    void reset() {
+        for(size_t i = 0; i < m_pF.size(); ++i) m_pF[i] = 0.0;
+        m_history.assign(m_pF.size(), (TCalc)0);
+        m_wrPos = m_interpolation;
         m_T = 0.0;
         m_inT = 0;
-        return (m_dT > 0.0);
+        m_format.reset();
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \return задержка в сэмплах входного сигнала, (N+1)/2
+     */
+    double latency() const {
+        return (double)m_Hinterpolation + 1.0;
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \return задержка в сэмплах выходного сигнала
+     */
+    double latency_out() const {
+        return latency() / m_dT;
     }
 
     /** \brief Инициализация класса
@@ -152,24 +579,22 @@ public:
      * \param out выходной буфер, должен иметь достаточный размер
      * \return количество сэмплов в выходном буфере
      */
-    int process(std::vector<T> &in, std::vector<T> &out) {
+    int process(std::vector<T> &in, std::vector<TOut> &out) {
+        if(std::is_floating_point<T>::value || std::is_floating_point<TOut>::value)
+            return process_float(in, out);
         int outCount = 0;
         int s = 0;
         while(true) {
             while(m_inT <= (int)m_T) {
-                m_inT++;
-                m_pF[m_wrPos++] = in[s++];
-                if(m_wrPos > m_interpolation) m_wrPos = 0;
+                // сэмплы закончились, все доступные выходные сэмплы уже выданы
                 if(s >= (int)in.size()) {
-                    if( m_inT < m_T ) {
-                        m_T = m_T - (double)m_inT;
-                        m_inT = 0;
-                    } else {
-                        m_inT = m_inT - (int)m_T;
-                        m_T = m_T - (double)(int)m_T;
-                    }
+                    m_T = m_T - (double)m_inT;
+                    m_inT = 0;
                     return outCount;
                 }
+                m_inT++;
+                m_pF[m_wrPos++] = in[s++];
+                if(m_wrPos > m_interpolation) m_wrPos = 0;
             }
 
             double D = (double)m_Hinterpolation + m_T - (double)(int)m_T;
@@ -191,14 +616,8 @@ public:
                 if(++index > m_interpolation) index = 0;
             }
 
-            // ограничение амплитуды
-            if(fout > std::numeric_limits<T>::max())
-                    fout = std::numeric_limits<T>::max();
-
-            if(fout < std::numeric_limits<T>::lowest())
-                    fout = std::numeric_limits<T>::lowest();
-
-            out.push_back(fout);
+            // преобразование формата и ограничение амплитуды
+            out.push_back(m_format.convert(fout));
             outCount++;
             //out[outCount++] = (short)iout;
             //
@@ -216,23 +635,371 @@ public:
         return outCount;
         */
     }
+
+    /** \brief Выдать оставшиеся сэмплы
+     * Вход дополняется нулями на величину задержки, после чего
+     * состояние преобразователя сбрасывается для нового потока.
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int flush(std::vector<TOut> &out) {
+        std::vector<T> tail((size_t)std::ceil(latency()), (T)0);
+        int outCount = process(tail, out);
+        reset();
+        return outCount;
+    }
+};
+
+/** \brief Быстрое преобразование Фурье со смешанным основанием
+ * Размер преобразования должен раскладываться на множители 2, 3, 5 и 7,
+ * что покрывает все распространённые частоты дискретизации (8000, 11025, 44100, 48000 и т.д.).
+ * Используется при расчёте коэффициентов фильтров и в блочном преобразователе SrcFirFft.
+ */
+class SrcFft {
+private:
+    int m_size;
+    std::vector<int> m_factors;
+    std::vector<double> m_cos;
+    std::vector<double> m_sin;
+    std::vector<double> m_work_re;
+    std::vector<double> m_work_im;
+
+    /** \brief Один этап алгоритма Стокхэма (прореживание по частоте)
+     * \param n длина подпоследовательности на этом этапе
+     * \param s шаг между подпоследовательностями
+     * \param p основание этапа
+     * \param sign знак мнимой части поворачивающих множителей
+     */
+    void stage(int n, int s, int p,
+            const double *x_re, const double *x_im,
+            double *y_re, double *y_im, double sign) {
+        const int m = n / p;
+        const int root = m_size / p;
+        double a_re[8], a_im[8];
+        double w_re[8], w_im[8];
+        // матрица ДПФ порядка p
+        double d_re[8][8], d_im[8][8];
+        for(int k = 0; k < p; ++k) {
+            for(int r = 0; r < p; ++r) {
+                int w = ((r * k) % p) * root;
+                d_re[k][r] = m_cos[w];
+                d_im[k][r] = sign * m_sin[w];
+            }
+        }
+        for(int q = 0; q < m; ++q) {
+            // поворачивающие множители exp(-2 pi i q k / n)
+            for(int k = 0; k < p; ++k) {
+                int w = (int)(((long long)q * k * s) % m_size);
+                w_re[k] = m_cos[w];
+                w_im[k] = sign * m_sin[w];
+            }
+            for(int t = 0; t < s; ++t) {
+                const int in_pos = t + s * q;
+                const int out_pos = t + s * p * q;
+                if(p == 2) {
+                    double b_re = x_re[in_pos + s * m];
+                    double b_im = x_im[in_pos + s * m];
+                    double sum_re = x_re[in_pos] - b_re;
+                    double sum_im = x_im[in_pos] - b_im;
+                    y_re[out_pos] = x_re[in_pos] + b_re;
+                    y_im[out_pos] = x_im[in_pos] + b_im;
+                    y_re[out_pos + s] = sum_re * w_re[1] - sum_im * w_im[1];
+                    y_im[out_pos + s] = sum_re * w_im[1] + sum_im * w_re[1];
+                    continue;
+                }
+                if(p == 4) {
+                    double x0_re = x_re[in_pos], x0_im = x_im[in_pos];
+                    double x1_re = x_re[in_pos + s * m], x1_im = x_im[in_pos + s * m];
+                    double x2_re = x_re[in_pos + 2 * s * m], x2_im = x_im[in_pos + 2 * s * m];
+                    double x3_re = x_re[in_pos + 3 * s * m], x3_im = x_im[in_pos + 3 * s * m];
+                    double s02_re = x0_re + x2_re, s02_im = x0_im + x2_im;
+                    double d02_re = x0_re - x2_re, d02_im = x0_im - x2_im;
+                    double s13_re = x1_re + x3_re, s13_im = x1_im + x3_im;
+                    // (x1 - x3) * (-i * sign)
+                    double d13_re = sign * (x1_im - x3_im);
+                    double d13_im = -sign * (x1_re - x3_re);
+                    a_re[0] = s02_re + s13_re; a_im[0] = s02_im + s13_im;
+                    a_re[1] = d02_re + d13_re; a_im[1] = d02_im + d13_im;
+                    a_re[2] = s02_re - s13_re; a_im[2] = s02_im - s13_im;
+                    a_re[3] = d02_re - d13_re; a_im[3] = d02_im - d13_im;
+                    y_re[out_pos] = a_re[0];
+                    y_im[out_pos] = a_im[0];
+                    for(int k = 1; k < 4; ++k) {
+                        y_re[out_pos + s * k] = a_re[k] * w_re[k] - a_im[k] * w_im[k];
+                        y_im[out_pos + s * k] = a_re[k] * w_im[k] + a_im[k] * w_re[k];
+                    }
+                    continue;
+                }
+                for(int r = 0; r < p; ++r) {
+                    a_re[r] = x_re[in_pos + s * m * r];
+                    a_im[r] = x_im[in_pos + s * m * r];
+                }
+                for(int k = 0; k < p; ++k) {
+                    double sum_re = a_re[0];
+                    double sum_im = a_im[0];
+                    for(int r = 1; r < p; ++r) {
+                        sum_re += a_re[r] * d_re[k][r] - a_im[r] * d_im[k][r];
+                        sum_im += a_re[r] * d_im[k][r] + a_im[r] * d_re[k][r];
+                    }
+                    y_re[out_pos + s * k] = sum_re * w_re[k] - sum_im * w_im[k];
+                    y_im[out_pos + s * k] = sum_re * w_im[k] + sum_im * w_re[k];
+                }
+            }
+        }
+    }
+
+public:
+
+    SrcFft() {
+        init(1);
+    }
+
+    /** \brief Инициализация класса
+     * \param size размер преобразования
+     */
+    SrcFft(int size) {
+        init(size);
+    }
+
+    /** \brief Проверить, поддерживается ли размер преобразования
+     * \param size размер преобразования
+     * \return true, если size раскладывается на множители 2, 3, 5 и 7
+     */
+    static bool is_supported(int size) {
+        if(size < 1) return false;
+        const int RADIX[4] = {2, 3, 5, 7};
+        for(int i = 0; i < 4; ++i)
+            while(size % RADIX[i] == 0) size /= RADIX[i];
+        return size == 1;
+    }
+
+    /** \brief Инициализация параметров
+     * \param size размер преобразования
+     * \return true, если успешна, иначе false
+     */
+    bool init(int size) {
+        if(!is_supported(size))
+            return false;
+        m_size = size;
+        m_factors.clear();
+        const int RADIX[5] = {4, 2, 3, 5, 7};
+        for(int i = 0; i < 5; ++i) {
+            while(size % RADIX[i] == 0) {
+                m_factors.push_back(RADIX[i]);
+                size /= RADIX[i];
+            }
+        }
+        // поворачивающие множители
+        const double DOUBLE_MATH_PI = 3.141592653589793238463;
+        m_cos.resize(m_size);
+        m_sin.resize(m_size);
+        for(int i = 0; i < m_size; ++i) {
+            m_cos[i] = std::cos(2.0 * DOUBLE_MATH_PI * (double)i / (double)m_size);
+            m_sin[i] = -std::sin(2.0 * DOUBLE_MATH_PI * (double)i / (double)m_size);
+        }
+        m_work_re.resize(m_size);
+        m_work_im.resize(m_size);
+        return true;
+    }
+
+    /** \brief Получить размер преобразования
+     * \return размер преобразования
+     */
+    int size() const {
+        return m_size;
+    }
+
+    /** \brief Выполнить преобразование на месте
+     * \param re действительная часть, размер не меньше size()
+     * \param im мнимая часть, размер не меньше size()
+     * \param is_inverse обратное преобразование (с нормировкой на size())
+     */
+    void transform(std::vector<double> &re, std::vector<double> &im, bool is_inverse = false) {
+        double sign = is_inverse ? -1.0 : 1.0;
+        double *x_re = &re[0];
+        double *x_im = &im[0];
+        double *y_re = &m_work_re[0];
+        double *y_im = &m_work_im[0];
+        int n = m_size;
+        int s = 1;
+        for(size_t i = 0; i < m_factors.size(); ++i) {
+            stage(n, s, m_factors[i], x_re, x_im, y_re, y_im, sign);
+            n /= m_factors[i];
+            s *= m_factors[i];
+            std::swap(x_re, y_re);
+            std::swap(x_im, y_im);
+        }
+        // результат остался в рабочем буфере
+        if(x_re != &re[0]) {
+            std::copy(x_re, x_re + m_size, re.begin());
+            std::copy(x_im, x_im + m_size, im.begin());
+        }
+        if(is_inverse) {
+            double scale = 1.0 / (double)m_size;
+            for(int i = 0; i < m_size; ++i) {
+                re[i] *= scale;
+                im[i] *= scale;
+            }
+        }
+    }
 };
 
+/** \brief Файл, отображённый в память только для чтения
+ * Используется для загрузки таблиц коэффициентов фильтров:
+ * страницы файла загружаются по мере обращения и разделяются
+ * между всеми процессами, отобразившими тот же файл.
+ */
+class SrcMappedFile {
+private:
+    const char *m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+    SrcMappedFile(const SrcMappedFile &);
+    SrcMappedFile &operator=(const SrcMappedFile &);
+public:
+
+    SrcMappedFile() : m_data(NULL), m_size(0) {
+#ifdef _WIN32
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = NULL;
+#endif
+    }
+
+    ~SrcMappedFile() {
+        close();
+    }
+
+    /** \brief Отобразить файл в память
+     * \param file_name имя файла
+     * \return true, если успешно, иначе false
+     */
+    bool open(const std::string &file_name) {
+        close();
+#ifdef _WIN32
+        m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(m_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(m_file, &file_size) || file_size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(m_mapping == NULL) {
+            close();
+            return false;
+        }
+        m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if(m_data == NULL) {
+            close();
+            return false;
+        }
+        m_size = (size_t)file_size.QuadPart;
+#else
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        // дескриптор после отображения не нужен
+        ::close(fd);
+        if(data == MAP_FAILED)
+            return false;
+        m_data = (const char*)data;
+        m_size = (size_t)file_stat.st_size;
+#endif
+        return true;
+    }
+
+    /** \brief Закрыть файл
+     */
+    void close() {
+#ifdef _WIN32
+        if(m_data != NULL) UnmapViewOfFile(m_data);
+        if(m_mapping != NULL) CloseHandle(m_mapping);
+        if(m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if(m_data != NULL) munmap((void*)m_data, m_size);
+#endif
+        m_data = NULL;
+        m_size = 0;
+    }
+
+    /** \brief Получить указатель на содержимое файла
+     * \return указатель на начало файла или NULL
+     */
+    const char *data() const {
+        return m_data;
+    }
+
+    /** \brief Получить размер файла
+     * \return размер в байтах
+     */
+    size_t size() const {
+        return m_size;
+    }
+};
 
 /** \brief Преобразователь частоты дискретизации с помощью КИХ-фильтра.
- * Выходной сигнал имеет задержку, зависящую от длины фильтра.
+ * Выходной сигнал имеет задержку, зависящую от длины фильтра (см. latency()).
+ * Фильтр с минимальной фазой уменьшает задержку до нескольких сэмплов
+ * ценой нелинейной фазовой характеристики. Он рассчитывается через БПФ
+ * размером не меньше 4 * oversampling * mul, поэтому oversampling * mul
+ * для него ограничено MAX_MIN_PHASE_LENGTH.
  * Для экономии памяти и увеличения качества при небольших значениях
  * oversampling можно добавить вычисление методом линейной интерполяции
  * отсутствующих значений КИХ фильтра.
+ * Таблицу коэффициентов можно сохранить в файл и при следующих запусках
+ * отображать её в память вместо расчёта (см. init() с параметром table_file_name).
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
  */
-template <typename T>
+template <typename T, typename TOut = T>
 class SrcFir {
 private:
+    /** \brief Заголовок файла с таблицей коэффициентов
+     * За заголовком следуют size коэффициентов типа double.
+     */
+    struct TableHeader {
+        char magic[8];              ///< "SRCFIR\0\0"
+        unsigned int version;       ///< версия формата файла
+        unsigned int byte_order;    ///< 0x01020304 в порядке байт записавшей машины
+        int oversampling;
+        int mul;
+        int is_min_phase;
+        int reserved;
+        double delay;               ///< задержка фильтра в сэмплах входного сигнала
+        long long size;             ///< количество коэффициентов
+        char padding[16];           ///< выравнивание коэффициентов
+    };
+
+    static const unsigned int TABLE_VERSION = 1;
+    static const unsigned int TABLE_BYTE_ORDER = 0x01020304;
+    // наибольшая длина фильтра с минимальной фазой, БПФ для неё занимает около 50 МБ
+    static const int MAX_MIN_PHASE_LENGTH = 1 << 18;
+
     unsigned char m_mul_count;
     int m_oversampling;
     int m_fir_length1;
+    int m_fir_size;
     std::vector<double> m_fir;
+    std::shared_ptr<SrcMappedFile> m_table_file;
     std::vector<double> m_buff;
+    bool m_is_min_phase;
+    double m_delay;
+    SrcSampleFormat<T, TOut> m_format;
+    int m_in_rate;
+    int m_out_rate;
     double m_dT;
     double m_T;
     int m_inT;
@@ -252,51 +1019,88 @@ private:
             (A2 * std::cos((4.0 * DOUBLE_MATH_PI * (double)i)/N_SUB1));
     }
 
-public:
+    /** \brief Преобразовать фильтр в фильтр с минимальной фазой
+     * Используется кепстральный метод: амплитудная характеристика
+     * сохраняется, а фаза восстанавливается по каузальной части кепстра.
+     * Размер БПФ не меньше учетверённой длины фильтра.
+     * На входе m_fir содержит половину симметричного фильтра,
+     * на выходе - все oversampling * mul коэффициентов.
+     */
+    void calc_min_phase() {
+        int length = m_oversampling * m_mul_count;
+        int fft_size = 1;
+        while(fft_size < 4 * length) fft_size <<= 1;
+        SrcFft fft(fft_size);
+        std::vector<double> re(fft_size, 0.0);
+        std::vector<double> im(fft_size, 0.0);
+        for(int i = 0; i < (int)m_fir.size(); ++i) {
+            re[i] = m_fir[i];
+            re[length - 1 - i] = m_fir[i];
+        }
 
-    SrcFir() {
-        init(1, 1, 1, 1);
-    }
+        // логарифм амплитудной характеристики,
+        // нули в полосе подавления ограничиваем снизу
+        fft.transform(re, im);
+        double max_mag = 0.0;
+        for(int i = 0; i < fft_size; ++i) {
+            re[i] = std::sqrt(re[i] * re[i] + im[i] * im[i]);
+            im[i] = 0.0;
+            if(re[i] > max_mag) max_mag = re[i];
+        }
+        const double MIN_MAG = max_mag * 1.0e-9;
+        for(int i = 0; i < fft_size; ++i)
+            re[i] = std::log((std::max)(re[i], MIN_MAG));
 
-    /** \brief Инициализация класса
-     * \param inSampleRate частота дискретизации входного сигнала
-     * \param outSampleRate частота дискретизации выходного сигнала
-     * \param oversampling частота дискретизации фильтра, определяет точность по оси времени.
-     * если не используется интерполяция коэффициентов фильтра, стоит использовать значение не менее 1024.
-     * в аппаратных ПЧД используется 1048576.
-     * таблица коэффициентов фильтра имеет размер oversampling * mul.
-     * произведение oversampling * mul должно быть чётным для
-     * расчёта фильтра чётного порядка, что позволяет хранить
-     * только половину коэффициентов и съэкономить память.
-     * \param mul - желаемое число умножений при фильтрации, определяет загрузку процессора.
-     */
-    SrcFir(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul) {
-        init(inSampleRate, outSampleRate, oversampling, mul);
-    }
+        // кепстр, оставляем только каузальную часть
+        fft.transform(re, im, true);
+        for(int i = 1; i < (fft_size >> 1); ++i)
+            re[i] *= 2.0;
+        for(int i = (fft_size >> 1) + 1; i < fft_size; ++i)
+            re[i] = 0.0;
+        for(int i = 0; i < fft_size; ++i)
+            im[i] = 0.0;
 
+        // обратно в частотную область и экспонента
+        fft.transform(re, im);
+        for(int i = 0; i < fft_size; ++i) {
+            double mag = std::exp(re[i]);
+            double phase = im[i];
+            re[i] = mag * std::cos(phase);
+            im[i] = mag * std::sin(phase);
+        }
+        fft.transform(re, im, true);
 
-    /** \brief Инициализация параметров
-     * \param inSampleRate частота дискретизации входного сигнала
-     * \param outSampleRate частота дискретизации выходного сигнала
-     * \param oversampling частота дискретизации фильтра, определяет точность по оси времени.
-     * если не используется интерполяция коэффициентов фильтра, стоит использовать значение не менее 1024.
-     * в аппаратных ПЧД используется 1048576.
-     * таблица коэффициентов фильтра имеет размер oversampling * mul.
-     * произведение oversampling * mul должно быть чётным для
-     * расчёта фильтра чётного порядка, что позволяет хранить
-     * только половину коэффициентов и съэкономить память.
-     * \param mul - желаемое число умножений при фильтрации, определяет загрузку процессора.
-     * \return true, если успешна, иначе false
+        m_fir.resize(length);
+        for(int i = 0; i < length; ++i)
+            m_fir[i] = re[i];
+    }
+
+    /** \brief Установить параметры преобразователя
+     * \return true, если параметры допустимы
      */
-    bool init(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul) {
+    bool set_param(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul, bool is_min_phase) {
         if((mul & oversampling & 1) != 0)
             return false;
+        if(is_min_phase && (long long)oversampling * mul > MAX_MIN_PHASE_LENGTH)
+            return false;
 
         m_oversampling = oversampling;
         m_mul_count = mul;
-        m_fir_length1 = m_oversampling * m_mul_count;
+        m_is_min_phase = is_min_phase;
+        m_fir_length1 = m_oversampling * m_mul_count - 1;
+        m_table_file.reset();
+        m_buff.resize(m_mul_count + 1);
+        m_in_rate = inSampleRate;
+        m_out_rate = outSampleRate;
+        m_dT = (double)inSampleRate / (double)outSampleRate;
+        return true;
+    }
 
-        m_fir.resize((m_fir_length1 >> 1));
+    /** \brief Рассчитать таблицу коэффициентов фильтра
+     */
+    void calc_fir() {
+        int length = m_fir_length1 + 1;
+        m_fir.resize((length >> 1));
 
         // расчитываем фильтр для половины частоты дискретизации
         // так как рабочая частота повышена в oversampling раз,
@@ -311,36 +1115,328 @@ public:
         double c = (double)m_fir.size() - 0.5;
         for(size_t i = 0; i < m_fir.size(); ++i) {
             double d = (double)i - c;
-            m_fir[i] = std::sin(w * d) / d * get_window_blackman(i, m_fir_length1);
+            m_fir[i] = std::sin(w * d) / d * get_window_blackman(i, length);
             sum += m_fir[i] + m_fir[i];
         }
 
-        m_fir_length1--;
-
         // нормализация и масштабирование
-        sum /= oversampling;
+        sum /= m_oversampling;
         for(size_t i = 0; i < m_fir.size(); ++i)
             m_fir[i] /= sum;
 
-        m_buff.resize(m_mul_count + 1);
+        if(m_is_min_phase) {
+            calc_min_phase();
+            // повторная нормализация и расчёт групповой задержки на нулевой частоте
+            sum = 0.0;
+            double moment = 0.0;
+            for(size_t i = 0; i < m_fir.size(); ++i) {
+                sum += m_fir[i];
+                moment += (double)i * m_fir[i];
+            }
+            m_delay = moment / sum / (double)m_oversampling;
+            sum /= m_oversampling;
+            for(size_t i = 0; i < m_fir.size(); ++i)
+                m_fir[i] /= sum;
+        } else {
+            m_delay = (double)m_fir_length1 / (2.0 * (double)m_oversampling);
+        }
+        m_fir_size = (int)m_fir.size();
+    }
 
-        for(int i = m_mul_count; i-- > 0;) m_buff[i] = 0;
-        m_dT = (double)inSampleRate / (double)outSampleRate;
-        m_T = 0.0;
-        m_inT = 0;
+    /** \brief Отобразить в память таблицу коэффициентов из файла
+     * \param file_name имя файла
+     * \return true, если файл содержит таблицу для текущих параметров
+     */
+    bool load_table(const std::string &file_name) {
+        std::shared_ptr<SrcMappedFile> file(new SrcMappedFile());
+        if(!file->open(file_name) || file->size() < sizeof(TableHeader))
+            return false;
+        TableHeader header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        long long size = m_is_min_phase ? m_fir_length1 + 1 : (m_fir_length1 + 1) >> 1;
+        if(std::memcmp(header.magic, "SRCFIR\0\0", sizeof(header.magic)) != 0 ||
+            header.version != TABLE_VERSION ||
+            header.byte_order != TABLE_BYTE_ORDER ||
+            header.oversampling != m_oversampling ||
+            header.mul != m_mul_count ||
+            header.is_min_phase != (m_is_min_phase ? 1 : 0) ||
+            header.size != size ||
+            file->size() < sizeof(header) + sizeof(double) * (size_t)size)
+            return false;
+        m_table_file = file;
+        m_delay = header.delay;
+        m_fir_size = (int)size;
+        std::vector<double>().swap(m_fir);
         return true;
     }
 
+    /** \brief Получить таблицу коэффициентов фильтра
+     * \return указатель на коэффициенты в памяти или в отображённом файле
+     */
+    const double *get_fir() const {
+        if(m_table_file) return (const double*)(m_table_file->data() + sizeof(TableHeader));
+        return &m_fir[0];
+    }
+
+    /** \brief Фильтрация
+     * \param fir таблица коэффициентов фильтра
+     * \param buff последний входной сэмпл линии задержки,
+     * предыдущие сэмплы расположены с шагом STEP
+     * \param shift начальное смещение в таблице коэффициентов
+     * \return выходной сэмпл
+     */
+    template <int STEP>
+    inline double filter(const double *fir, const double *buff, int shift) const {
+        double fout = 0.0;
+        int k;
+        if(m_is_min_phase) {
+            // таблица фильтра хранится целиком
+            for(k = shift; k <= m_fir_length1; k += m_oversampling, buff += STEP)
+                fout += fir[k] * *buff;
+        } else {
+            // первая половина КИХ-фильтра
+            for(k = shift; k < m_fir_size; k += m_oversampling, buff += STEP)
+                fout += fir[k] * *buff;
+            // вторая половина КИХ-фильтра
+            for( k = m_fir_length1 - k; k >= 0; k -= m_oversampling, buff += STEP)
+                fout += fir[k] * *buff;
+        }
+        return fout;
+    }
+
+public:
+
+    SrcFir() {
+        init(1, 1, 1, 1);
+    }
+
+    /** \brief Инициализация класса
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра, определяет точность по оси времени.
+     * если не используется интерполяция коэффициентов фильтра, стоит использовать значение не менее 1024.
+     * в аппаратных ПЧД используется 1048576.
+     * таблица коэффициентов фильтра имеет размер oversampling * mul.
+     * произведение oversampling * mul должно быть чётным для
+     * расчёта фильтра чётного порядка, что позволяет хранить
+     * только половину коэффициентов и съэкономить память.
+     * \param mul - желаемое число умножений при фильтрации, определяет загрузку процессора.
+     * \param is_min_phase использовать фильтр с минимальной фазой (малая задержка).
+     */
+    SrcFir(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul, bool is_min_phase = false) {
+        init(inSampleRate, outSampleRate, oversampling, mul, is_min_phase);
+    }
+
+    /** \brief Инициализация класса с таблицей коэффициентов в файле
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра
+     * \param mul желаемое число умножений при фильтрации
+     * \param is_min_phase использовать фильтр с минимальной фазой
+     * \param table_file_name имя файла с таблицей коэффициентов
+     */
+    SrcFir(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul, bool is_min_phase,
+            const std::string &table_file_name) {
+        init(inSampleRate, outSampleRate, oversampling, mul, is_min_phase, table_file_name);
+    }
+
+
+    /** \brief Инициализация параметров
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра, определяет точность по оси времени.
+     * если не используется интерполяция коэффициентов фильтра, стоит использовать значение не менее 1024.
+     * в аппаратных ПЧД используется 1048576.
+     * таблица коэффициентов фильтра имеет размер oversampling * mul.
+     * произведение oversampling * mul должно быть чётным для
+     * расчёта фильтра чётного порядка, что позволяет хранить
+     * только половину коэффициентов и съэкономить память.
+     * \param mul - желаемое число умножений при фильтрации, определяет загрузку процессора.
+     * \param is_min_phase использовать фильтр с минимальной фазой (малая задержка).
+     * таблица коэффициентов такого фильтра не симметрична и хранится целиком,
+     * oversampling * mul не должно превышать MAX_MIN_PHASE_LENGTH (262144).
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul, bool is_min_phase = false) {
+        if(!set_param(inSampleRate, outSampleRate, oversampling, mul, is_min_phase))
+            return false;
+        calc_fir();
+        reset();
+        return true;
+    }
+
+    /** \brief Инициализация параметров с таблицей коэффициентов в файле
+     * Если файл существует и содержит таблицу для тех же oversampling, mul и is_min_phase,
+     * он отображается в память и коэффициенты не рассчитываются.
+     * Страницы файла разделяются между всеми процессами, использующими ту же таблицу,
+     * а копии преобразователя разделяют одно отображение.
+     * Иначе таблица рассчитывается и сохраняется в файл для следующих запусков.
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра
+     * \param mul желаемое число умножений при фильтрации
+     * \param is_min_phase использовать фильтр с минимальной фазой
+     * \param table_file_name имя файла с таблицей коэффициентов
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, int outSampleRate, int oversampling, unsigned char mul, bool is_min_phase,
+            const std::string &table_file_name) {
+        if(!set_param(inSampleRate, outSampleRate, oversampling, mul, is_min_phase))
+            return false;
+        if(!load_table(table_file_name)) {
+            calc_fir();
+            save_table(table_file_name);
+        }
+        reset();
+        return true;
+    }
+
+    /** \brief Сохранить таблицу коэффициентов в файл
+     * Файл сначала записывается под временным именем и затем переименовывается,
+     * поэтому другие процессы не увидят частично записанную таблицу.
+     * \param file_name имя файла
+     * \return true, если успешно, иначе false
+     */
+    bool save_table(const std::string &file_name) const {
+        TableHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "SRCFIR\0\0", sizeof(header.magic));
+        header.version = TABLE_VERSION;
+        header.byte_order = TABLE_BYTE_ORDER;
+        header.oversampling = m_oversampling;
+        header.mul = m_mul_count;
+        header.is_min_phase = m_is_min_phase ? 1 : 0;
+        header.delay = m_delay;
+        header.size = m_fir_size;
+
+        std::string temp_file_name = file_name + "." +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        std::ofstream file(temp_file_name.c_str(), std::ios::binary);
+        if(!file.is_open())
+            return false;
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)get_fir(), (std::streamsize)(sizeof(double) * m_fir_size));
+        file.close();
+        if(!file) {
+            std::remove(temp_file_name.c_str());
+            return false;
+        }
+        if(std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+            // на некоторых системах rename не заменяет существующий файл
+            std::remove(file_name.c_str());
+            if(std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+                std::remove(temp_file_name.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** \brief Включить или выключить TPDF дизеринг выходного сигнала
+     * Имеет смысл только для целого типа выходных сэмплов.
+     * Для независимого дизеринга в разных преобразователях задайте разные seed.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора, восстанавливается в reset()
+     */
+    void set_dither(bool is_dither, unsigned int seed = SrcSampleFormat<T, TOut>::DEFAULT_SEED) {
+        m_format.set_dither(is_dither, seed);
+    }
+
+    /** \brief Сбросить состояние преобразователя без изменения параметров
+     */
+    void reset() {
+        for(int i = m_mul_count; i-- > 0;) m_buff[i] = 0;
+        m_T = 0.0;
+        m_inT = 0;
+        m_format.reset();
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * Для фильтра с линейной фазой задержка равна половине длины фильтра,
+     * для фильтра с минимальной фазой - групповой задержке на нулевой частоте.
+     * \return задержка в сэмплах входного сигнала
+     */
+    double latency() const {
+        return m_delay;
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \return задержка в сэмплах выходного сигнала
+     */
+    double latency_out() const {
+        return m_delay / m_dT;
+    }
+
+    /** \brief Получить номер входного сэмпла, последним попавшего в линию задержки
+     * перед вычислением выходного сэмпла
+     * \param index номер выходного сэмпла от начала потока
+     * \return номер входного сэмпла от начала потока
+     */
+    long long get_in_index(long long index) const {
+        return index * m_in_rate / m_out_rate;
+    }
+
+    /** \brief Получить количество выходных сэмплов
+     * \param in_count количество входных сэмплов от начала потока
+     * \return количество выходных сэмплов, которое выдаст process()
+     */
+    long long get_out_count(long long in_count) const {
+        return (in_count * m_out_rate + m_in_rate - 1) / m_in_rate;
+    }
+
+    /** \brief Вычислить выходной сэмпл по внешней линии задержки
+     * Позволяет нескольким потокам выходных сэмплов использовать
+     * одну таблицу коэффициентов и один буфер входного сигнала.
+     * \param history указатель на последний входной сэмпл, перед ним в памяти
+     * должны находиться не менее mul предыдущих сэмплов
+     * \param frac дробная часть фазы выходного сэмпла, от 0 до 1
+     * \return выходной сэмпл без преобразования формата
+     */
+    inline double calc_sample(const double *history, double frac) const {
+        return filter<-1>(get_fir(), history, (int)(0.5 + m_oversampling * frac));
+    }
+
+    /** \brief Получить желаемое число умножений при фильтрации
+     * \return длина линии задержки в сэмплах
+     */
+    int get_mul() const {
+        return m_mul_count;
+    }
+
+    /** \brief Перейти к выходному сэмплу с заданным номером
+     * Фаза выходного сэмпла вычисляется по отношению частот без обработки
+     * предыдущих сэмплов. Состояние сбрасывается, после чего в process() нужно
+     * передать mul входных сэмплов начиная с возвращённого номера
+     * (отрицательным номерам соответствуют нули), чтобы заполнить линию задержки.
+     * Первым выходным сэмплом будет сэмпл с номером index.
+     * \param index номер выходного сэмпла от начала потока
+     * \return номер первого входного сэмпла, который нужно передать в process()
+     */
+    long long seek(long long index) {
+        reset();
+        long long n = get_in_index(index);
+        long long rem = index * m_in_rate - n * m_out_rate;
+        m_T = (double)(m_mul_count - 1) + (double)rem / (double)m_out_rate;
+        return n - m_mul_count + 1;
+    }
+
     /** \brief Преобразовать частоту дискретизации
      * \param in входной буфер
      * \param out выходной буфер, должен иметь достаточный размер
      * \return количество сэмплов в выходном буфере
      */
-    int process(std::vector<T> &in, std::vector<T> &out) {
+    int process(std::vector<T> &in, std::vector<TOut> &out) {
          int outCount = 0;
          int s = 0;
+         const double *fir = get_fir();
          while(true) {
             while(m_inT <= m_T) {
+                // сэмплы закончились, все доступные выходные сэмплы уже выданы
+                if(s >= (int)in.size()) {
+                    m_T = m_T - (double)m_inT;
+                    m_inT = 0;
+                    return outCount;
+                }
                 m_inT++;
 
                 // буфер для фильтрации, линия задержки
@@ -348,16 +1444,6 @@ public:
                     m_buff[i] = m_buff[i - 1];
 
                 m_buff[0] = in[s++];
-                if(s >= (int)in.size()) {
-                    if( m_inT < m_T ) {
-                        m_T = m_T - (double)m_inT;
-                        m_inT = 0;
-                    } else {
-                        m_inT = m_inT - (int)m_T;
-                        m_T = m_T - (double)(int)m_T;
-                    }
-                    return outCount;
-                }
             }
 
             // ближайшее начальное смещение по временной оси
@@ -365,24 +1451,10 @@ public:
             // для увеличения точности при небольшом значении oversampling
             // можно дополнительно расчитать методом интерполяции
             // значение коэффицента фильтра в требуемой точке.
-            // фильтрация
-            double fout = 0.0;
-            int k, i;
-            // первая половина КИХ-фильтра
-            for(k = shift, i = 0; k < (int)m_fir.size(); k += m_oversampling)
-                fout += m_fir[k] * m_buff[i++];
-            // вторая половина КИХ-фильтра
-            for( k = m_fir_length1 - k; k >= 0; k -= m_oversampling)
-                fout += m_fir[k] * m_buff[i++];
-
-            // ограничение амплитуды
-            if(fout > std::numeric_limits<T>::max())
-                    fout = std::numeric_limits<T>::max();
+            double fout = filter<1>(fir, &m_buff[0], shift);
 
-            if(fout < std::numeric_limits<T>::lowest())
-                    fout = std::numeric_limits<T>::lowest();
-
-            out.push_back(fout);
+            // преобразование формата и ограничение амплитуды
+            out.push_back(m_format.convert(fout));
             outCount++;
             //out[outCount++] = (short)fout;
             //
@@ -400,6 +1472,705 @@ public:
         return outCount;
         */
     }
+
+    /** \brief Выдать оставшиеся сэмплы
+     * Вход дополняется нулями на величину задержки, после чего
+     * состояние преобразователя сбрасывается для нового потока.
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int flush(std::vector<TOut> &out) {
+        std::vector<T> tail((size_t)std::ceil(latency()), (T)0);
+        int outCount = process(tail, out);
+        reset();
+        return outCount;
+    }
+};
+
+/** \brief Преобразователь одного входного сигнала в несколько выходных
+ * с разными частотами дискретизации с помощью КИХ-фильтра.
+ * Результат для каждого выхода совпадает с SrcFir с теми же параметрами,
+ * но входной сигнал хранится в одном линейном буфере, общем для всех выходов,
+ * вместо отдельной линии задержки у каждого преобразователя,
+ * а таблица коэффициентов фильтра SrcFir не зависит от отношения частот
+ * и поэтому рассчитывается один раз для всех выходов.
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
+ */
+template <typename T, typename TOut = T>
+class SrcFirFanOut {
+private:
+    SrcFir<T, TOut> m_src;
+    std::vector<double> m_history;
+    std::vector<double> m_dT;
+    std::vector<double> m_T;
+    std::vector<SrcSampleFormat<T, TOut> > m_format;
+    int m_history_size;
+    std::vector<int> m_out_rate;
+
+public:
+
+    SrcFirFanOut() : m_history_size(0) {
+    }
+
+    /** \brief Инициализация класса
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRates частоты дискретизации выходных сигналов
+     * \param oversampling частота дискретизации фильтра (см. SrcFir)
+     * \param mul желаемое число умножений при фильтрации
+     * \param is_min_phase использовать фильтр с минимальной фазой
+     */
+    SrcFirFanOut(int inSampleRate, const std::vector<int> &outSampleRates, int oversampling,
+            unsigned char mul, bool is_min_phase = false) {
+        init(inSampleRate, outSampleRates, oversampling, mul, is_min_phase);
+    }
+
+    /** \brief Инициализация параметров
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRates частоты дискретизации выходных сигналов
+     * \param oversampling частота дискретизации фильтра (см. SrcFir)
+     * \param mul желаемое число умножений при фильтрации
+     * \param is_min_phase использовать фильтр с минимальной фазой
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, const std::vector<int> &outSampleRates, int oversampling,
+            unsigned char mul, bool is_min_phase = false) {
+        if(outSampleRates.empty() || !m_src.init(inSampleRate, inSampleRate, oversampling, mul, is_min_phase))
+            return false;
+        return set_outputs(inSampleRate, outSampleRates);
+    }
+
+    /** \brief Инициализация параметров с готовым фильтром
+     * Таблица коэффициентов берётся из src, в том числе из отображённого файла.
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRates частоты дискретизации выходных сигналов
+     * \param src преобразователь с рассчитанной таблицей коэффициентов
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, const std::vector<int> &outSampleRates, const SrcFir<T, TOut> &src) {
+        if(outSampleRates.empty())
+            return false;
+        m_src = src;
+        return set_outputs(inSampleRate, outSampleRates);
+    }
+
+    /** \brief Установить частоты выходных сигналов
+     */
+    bool set_outputs(int inSampleRate, const std::vector<int> &outSampleRates) {
+        m_out_rate = outSampleRates;
+        m_dT.resize(m_out_rate.size());
+        m_T.resize(m_out_rate.size());
+        m_format.resize(m_out_rate.size());
+        for(size_t j = 0; j < m_out_rate.size(); ++j) {
+            if(m_out_rate[j] <= 0)
+                return false;
+            m_dT[j] = (double)inSampleRate / (double)m_out_rate[j];
+        }
+        m_history_size = m_src.get_mul();
+        reset();
+        return true;
+    }
+
+    /** \brief Включить или выключить TPDF дизеринг выходных сигналов
+     * Начальные значения генераторов выходов получаются из seed
+     * и различаются, чтобы дизеринг выходов не был коррелирован.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора первого выхода
+     */
+    void set_dither(bool is_dither, unsigned int seed = SrcSampleFormat<T, TOut>::DEFAULT_SEED) {
+        for(size_t j = 0; j < m_format.size(); ++j)
+            m_format[j].set_dither(is_dither, seed + (unsigned int)j * 0x9E3779B9U);
+    }
+
+    /** \brief Сбросить состояние преобразователя без изменения параметров
+     */
+    void reset() {
+        m_history.assign(m_history_size, 0.0);
+        for(size_t j = 0; j < m_T.size(); ++j) {
+            m_T[j] = 0.0;
+            m_format[j].reset();
+        }
+    }
+
+    /** \brief Получить количество выходных сигналов
+     * \return количество выходных сигналов
+     */
+    size_t size() const {
+        return m_out_rate.size();
+    }
+
+    /** \brief Получить задержку выходных сигналов
+     * \return задержка в сэмплах входного сигнала, одинаковая для всех выходов
+     */
+    double latency() const {
+        return m_src.latency();
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \param index номер выходного сигнала
+     * \return задержка в сэмплах выходного сигнала
+     */
+    double latency_out(size_t index) const {
+        return m_src.latency() / m_dT[index];
+    }
+
+    /** \brief Преобразовать частоту дискретизации
+     * \param in входной буфер
+     * \param out выходные буферы, по одному на каждую выходную частоту,
+     * сэмплы добавляются в конец
+     * \return общее количество выходных сэмплов
+     */
+    int process(std::vector<T> &in, std::vector<std::vector<TOut> > &out) {
+        out.resize(m_out_rate.size());
+        if(in.empty()) return 0;
+        // входной сигнал добавляется к последним mul сэмплам предыдущего блока
+        m_history.resize(m_history_size + in.size());
+        for(size_t i = 0; i < in.size(); ++i)
+            m_history[m_history_size + i] = in[i];
+        const double *current = &m_history[m_history_size];
+        const double in_count = (double)in.size();
+
+        int outCount = 0;
+        for(size_t j = 0; j < m_out_rate.size(); ++j) {
+            double t = m_T[j];
+            const double dT = m_dT[j];
+            std::vector<TOut> &buff = out[j];
+            SrcSampleFormat<T, TOut> &format = m_format[j];
+            while(t < in_count) {
+                int n = (int)t;
+                buff.push_back(format.convert(m_src.calc_sample(current + n, t - (double)n)));
+                outCount++;
+                t += dT;
+            }
+            m_T[j] = t - in_count;
+        }
+
+        // сохраняем последние mul сэмплов для следующего блока
+        std::copy(m_history.end() - m_history_size, m_history.end(), m_history.begin());
+        m_history.resize(m_history_size);
+        return outCount;
+    }
+
+    /** \brief Выдать оставшиеся сэмплы
+     * Вход дополняется нулями на величину задержки, после чего
+     * состояние преобразователя сбрасывается для нового потока.
+     * \param out выходные буферы
+     * \return общее количество сэмплов, добавленных в выходные буферы
+     */
+    int flush(std::vector<std::vector<TOut> > &out) {
+        std::vector<T> tail((size_t)std::ceil(latency()), (T)0);
+        int outCount = process(tail, out);
+        reset();
+        return outCount;
+    }
+};
+
+/** \brief Представление сигнала с изменённой частотой дискретизации
+ * с произвольным доступом к выходным сэмплам.
+ * Входной сигнал хранится в файле, отображённом в память (сэмплы типа T
+ * в порядке байт машины), или в памяти вызывающего кода.
+ * Для чтения диапазона выходных сэмплов преобразователь SrcFir переводится
+ * сразу на нужную фазу (см. SrcFir::seek()), линия задержки заполняется
+ * только mul предыдущими входными сэмплами, и вычисляется только запрошенный диапазон.
+ * Выходные сэмплы совпадают с результатом process() и flush() от начала сигнала
+ * с точностью до округления фазы. Дизеринг при этом не воспроизводится.
+ * Вычисленные блоки могут кэшироваться (см. set_cache()).
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
+ */
+template <typename T, typename TOut = T>
+class SrcFirView {
+private:
+    std::shared_ptr<SrcMappedFile> m_file;
+    const T *m_data;
+    long long m_in_size;
+    long long m_size;
+    SrcFir<T, TOut> m_src;
+    std::vector<T> m_in;
+    long long m_block_size;
+    size_t m_cache_blocks;
+    std::map<long long, std::vector<TOut>> m_cache;
+    std::deque<long long> m_cache_order;
+
+    /** \brief Вычислить диапазон выходных сэмплов
+     * \param index номер первого выходного сэмпла
+     * \param count количество сэмплов
+     * \param out выходной буфер, сэмплы добавляются в конец
+     */
+    void calc(long long index, long long count, std::vector<TOut> &out) {
+        const long long CHUNK_SIZE = 4096;
+        size_t start = out.size();
+        long long pos = m_src.seek(index);
+        long long last = m_src.get_in_index(index + count - 1);
+        while((long long)(out.size() - start) < count) {
+            // из-за округления фазы может понадобиться ещё один входной сэмпл
+            long long end = pos <= last ? (std::min)(pos + CHUNK_SIZE, last + 1) : pos + 1;
+            m_in.resize((size_t)(end - pos));
+            for(long long i = pos; i < end; ++i)
+                m_in[i - pos] = (i >= 0 && i < m_in_size) ? m_data[i] : (T)0;
+            m_src.process(m_in, out);
+            pos = end;
+        }
+        out.resize(start + count);
+    }
+
+    /** \brief Получить блок выходных сэмплов из кэша или вычислить его
+     * \param block номер блока
+     * \return блок выходных сэмплов
+     */
+    const std::vector<TOut> &get_block(long long block) {
+        typename std::map<long long, std::vector<TOut>>::iterator it = m_cache.find(block);
+        if(it != m_cache.end())
+            return it->second;
+        // вытесняем самые старые блоки
+        while(m_cache.size() >= m_cache_blocks) {
+            m_cache.erase(m_cache_order.front());
+            m_cache_order.pop_front();
+        }
+        std::vector<TOut> &data = m_cache[block];
+        long long index = block * m_block_size;
+        calc(index, (std::min)(m_block_size, m_size - index), data);
+        m_cache_order.push_back(block);
+        return data;
+    }
+
+    /** \brief Установить входной сигнал и преобразователь
+     */
+    void set_source(const T *data, long long size, const SrcFir<T, TOut> &src) {
+        m_data = data;
+        m_in_size = size;
+        m_src = src;
+        m_size = m_src.get_out_count(m_in_size + (long long)std::ceil(m_src.latency()));
+        clear_cache();
+    }
+
+public:
+
+    SrcFirView() : m_data(NULL), m_in_size(0), m_size(0), m_block_size(0), m_cache_blocks(0) {
+    }
+
+    /** \brief Открыть сигнал в файле
+     * \param file_name имя файла с сэмплами типа T
+     * \param src настроенный преобразователь, копируется вместе с таблицей коэффициентов
+     * \return true, если успешно, иначе false
+     */
+    bool open(const std::string &file_name, const SrcFir<T, TOut> &src) {
+        std::shared_ptr<SrcMappedFile> file(new SrcMappedFile());
+        if(!file->open(file_name) || file->size() < sizeof(T))
+            return false;
+        m_file = file;
+        set_source((const T*)m_file->data(), (long long)(m_file->size() / sizeof(T)), src);
+        return true;
+    }
+
+    /** \brief Открыть сигнал в памяти
+     * \param data сэмплы входного сигнала, должны существовать всё время работы
+     * \param size количество сэмплов
+     * \param src настроенный преобразователь
+     * \return true, если успешно, иначе false
+     */
+    bool open(const T *data, long long size, const SrcFir<T, TOut> &src) {
+        if(data == NULL || size <= 0)
+            return false;
+        m_file.reset();
+        set_source(data, size, src);
+        return true;
+    }
+
+    /** \brief Настроить кэш вычисленных блоков
+     * \param block_size размер блока в выходных сэмплах, 0 - без кэша
+     * \param block_count максимальное количество блоков в кэше
+     */
+    void set_cache(long long block_size, size_t block_count) {
+        m_block_size = block_count > 0 ? (std::max)(block_size, 0LL) : 0;
+        m_cache_blocks = block_count;
+        clear_cache();
+    }
+
+    /** \brief Очистить кэш
+     */
+    void clear_cache() {
+        m_cache.clear();
+        m_cache_order.clear();
+    }
+
+    /** \brief Получить длину сигнала
+     * \return количество выходных сэмплов с учётом задержки фильтра
+     */
+    long long size() const {
+        return m_size;
+    }
+
+    /** \brief Прочитать диапазон выходных сэмплов
+     * \param index номер первого выходного сэмпла
+     * \param count количество сэмплов
+     * \param out выходной буфер, сэмплы добавляются в конец
+     * \return количество прочитанных сэмплов, меньше count в конце сигнала
+     */
+    long long read(long long index, long long count, std::vector<TOut> &out) {
+        if(index < 0 || index >= m_size || count <= 0)
+            return 0;
+        count = (std::min)(count, m_size - index);
+        if(m_block_size <= 0) {
+            calc(index, count, out);
+            return count;
+        }
+        long long end = index + count;
+        for(long long block = index / m_block_size; block * m_block_size < end; ++block) {
+            const std::vector<TOut> &data = get_block(block);
+            long long block_start = block * m_block_size;
+            long long from = (std::max)(index, block_start) - block_start;
+            long long to = (std::min)(end, block_start + (long long)data.size()) - block_start;
+            out.insert(out.end(), data.begin() + from, data.begin() + to);
+        }
+        return count;
+    }
+};
+
+/** \brief Блочный преобразователь частоты дискретизации с КИХ-фильтром,
+ * выполняющий фильтрацию в частотной области методом перекрытия с накоплением (overlap-save).
+ * Отношение частот приводится к несократимой дроби up/down, блок входного сигнала
+ * размером down * 2^n переводится БПФ в частотную область, умножается на
+ * частотную характеристику фильтра и переносится в спектр выходного блока
+ * размером up * 2^n, после чего переводится обратно. Затраты на один выходной сэмпл
+ * растут как логарифм размера блока, а не как длина фильтра,
+ * поэтому при длинных фильтрах этот класс быстрее SrcFir (см. is_faster()).
+ * Фильтр тот же, что у SrcFir с линейной фазой и теми же oversampling и mul:
+ * его частотная характеристика рассчитывается по тем же коэффициентам,
+ * включая зеркальные и наложенные составляющие, поэтому результат совпадает
+ * с SrcFir с точностью до округления фазы в таблице SrcFir.
+ * up и down должны раскладываться на множители 2, 3, 5 и 7.
+ * Задержка выходного сигнала та же, что у SrcFir,
+ * кроме того выходные сэмплы выдаются целыми блоками.
+ * T - тип входных сэмплов, TOut - тип выходных сэмплов (см. SrcSampleFormat).
+ */
+template <typename T, typename TOut = T>
+class SrcFirFft {
+private:
+    int m_up;
+    int m_down;
+    int m_fir_length;
+    double m_delay;
+    int m_overlap;
+    int m_in_block;
+    int m_out_block;
+    SrcFft m_fft_in;
+    SrcFft m_fft_out;
+    std::vector<int> m_bin_in;
+    std::vector<int> m_bin_out;
+    std::vector<double> m_fir_re;
+    std::vector<double> m_fir_im;
+    std::vector<double> m_block;
+    int m_block_pos;
+    std::vector<double> m_re;
+    std::vector<double> m_im;
+    std::vector<double> m_out_re;
+    std::vector<double> m_out_im;
+    long long m_in_count;
+    long long m_out_count;
+    SrcSampleFormat<T, TOut> m_format;
+
+    /** \brief Наибольший общий делитель
+     */
+    static int get_gcd(int a, int b) {
+        while(b != 0) {
+            int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    /** \brief Рассчитать размеры блоков
+     * Перекрытие кратно down и с запасом покрывает длину фильтра,
+     * размер блока не меньше учетверённого перекрытия.
+     * \param up числитель отношения частот
+     * \param down знаменатель отношения частот
+     * \param fir_length длина фильтра в сэмплах входного сигнала
+     * \param overlap перекрытие блоков в сэмплах входного сигнала
+     * \param in_block размер входного блока
+     * \param out_block размер выходного блока
+     * \return true, если размеры блоков поддерживаются БПФ
+     */
+    static bool calc_blocks(int up, int down, int fir_length, int &overlap, int &in_block, int &out_block) {
+        const int MAX_BLOCK = 1 << 22;
+        if(!SrcFft::is_supported(up) || !SrcFft::is_supported(down))
+            return false;
+        int guard = fir_length + (fir_length >> 1);
+        overlap = ((guard + down - 1) / down) * down;
+        in_block = down;
+        out_block = up;
+        while(in_block < 4 * overlap || in_block < 2 * down) {
+            in_block <<= 1;
+            out_block <<= 1;
+            if(in_block > MAX_BLOCK || out_block > MAX_BLOCK)
+                return false;
+        }
+        return true;
+    }
+
+    /** \brief Обработать заполненный входной блок
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int process_block(std::vector<TOut> &out) {
+        for(int i = 0; i < m_in_block; ++i) {
+            m_re[i] = m_block[i];
+            m_im[i] = 0.0;
+        }
+        m_fft_in.transform(m_re, m_im);
+
+        // умножаем на частотную характеристику фильтра и переносим
+        // в спектр выходного блока, частоты выше половины размера
+        // выходного блока накладываются так же, как у SrcFir
+        for(int i = 0; i < m_out_block; ++i) {
+            m_out_re[i] = 0.0;
+            m_out_im[i] = 0.0;
+        }
+        for(size_t k = 0; k < m_bin_in.size(); ++k) {
+            int i = m_bin_in[k];
+            int o = m_bin_out[k];
+            m_out_re[o] += m_re[i] * m_fir_re[k] - m_im[i] * m_fir_im[k];
+            m_out_im[o] += m_re[i] * m_fir_im[k] + m_im[i] * m_fir_re[k];
+        }
+        m_fft_out.transform(m_out_re, m_out_im, true);
+
+        // начало блока искажено круговой свёрткой, его отбрасываем
+        int outCount = 0;
+        for(int i = m_overlap / m_down * m_up; i < m_out_block; ++i) {
+            double fout = m_out_re[i];
+
+            // преобразование формата и ограничение амплитуды
+            out.push_back(m_format.convert(fout));
+            outCount++;
+        }
+        m_out_count += outCount;
+
+        // хвост блока становится перекрытием для следующего
+        std::copy(m_block.end() - m_overlap, m_block.end(), m_block.begin());
+        m_block_pos = m_overlap;
+        return outCount;
+    }
+
+public:
+
+    static const int DEFAULT_OVERSAMPLING = 1024;
+
+    SrcFirFft() {
+        init(1, 1, 2);
+    }
+
+    /** \brief Инициализация класса
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param mul длина фильтра в сэмплах входного сигнала, как и у SrcFir.
+     */
+    SrcFirFft(int inSampleRate, int outSampleRate, int mul) {
+        init(inSampleRate, outSampleRate, mul);
+    }
+
+    /** \brief Инициализация класса
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра SrcFir с тем же результатом
+     * \param mul длина фильтра в сэмплах входного сигнала, как и у SrcFir.
+     */
+    SrcFirFft(int inSampleRate, int outSampleRate, int oversampling, int mul) {
+        init(inSampleRate, outSampleRate, oversampling, mul);
+    }
+
+    /** \brief Проверить, будет ли блочный преобразователь быстрее SrcFir
+     * Оценивается число умножений на один выходной сэмпл:
+     * у SrcFir это mul умножений и сдвиг линии задержки на каждый входной сэмпл,
+     * у SrcFirFft - два БПФ и перенос спектра с умножением на частотную
+     * характеристику на блок выходных сэмплов.
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param mul желаемое число умножений при фильтрации
+     * \return true, если стоит использовать SrcFirFft
+     */
+    static bool is_faster(int inSampleRate, int outSampleRate, int mul) {
+        if(inSampleRate <= 0 || outSampleRate <= 0 || mul < 2)
+            return false;
+        int gcd = get_gcd(inSampleRate, outSampleRate);
+        int up = outSampleRate / gcd;
+        int down = inSampleRate / gcd;
+        int overlap, in_block, out_block;
+        if(!calc_blocks(up, down, mul, overlap, in_block, out_block))
+            return false;
+        double ratio = (double)down / (double)up;
+        // сдвиг линии задержки дешевле умножений, его вклад подобран по замерам
+        double direct_cost = (double)mul * (1.0 + 0.4 * std::sqrt(ratio));
+        double fft_cost = 4.0 * ((double)in_block * std::log2((double)in_block) +
+            (double)out_block * std::log2((double)out_block)) +
+            4.0 * (double)in_block;
+        int hop = out_block - overlap / down * up;
+        return fft_cost / (double)hop < direct_cost;
+    }
+
+    /** \brief Инициализация параметров
+     * Фильтр совпадает с фильтром SrcFir с oversampling, равным DEFAULT_OVERSAMPLING.
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param mul длина фильтра в сэмплах входного сигнала, как и у SrcFir.
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, int outSampleRate, int mul) {
+        return init(inSampleRate, outSampleRate, DEFAULT_OVERSAMPLING, mul);
+    }
+
+    /** \brief Инициализация параметров
+     * \param inSampleRate частота дискретизации входного сигнала
+     * \param outSampleRate частота дискретизации выходного сигнала
+     * \param oversampling частота дискретизации фильтра SrcFir с тем же результатом
+     * \param mul длина фильтра в сэмплах входного сигнала, как и у SrcFir.
+     * \return true, если успешна, иначе false
+     */
+    bool init(int inSampleRate, int outSampleRate, int oversampling, int mul) {
+        if(inSampleRate <= 0 || outSampleRate <= 0 || mul < 2 || oversampling < 1 ||
+            ((mul & oversampling & 1) != 0))
+            return false;
+        int gcd = get_gcd(inSampleRate, outSampleRate);
+        m_up = outSampleRate / gcd;
+        m_down = inSampleRate / gcd;
+        m_fir_length = mul;
+        if(!calc_blocks(m_up, m_down, m_fir_length, m_overlap, m_in_block, m_out_block))
+            return false;
+        m_fft_in.init(m_in_block);
+        m_fft_out.init(m_out_block);
+
+        // импульсная характеристика SrcFir как функция задержки в сэмплах входного сигнала:
+        // коэффициент таблицы с номером x соответствует задержке x / oversampling.
+        // берём по 2 отсчёта на входной сэмпл, этого достаточно для
+        // частот до 1 (в долях частоты дискретизации входного сигнала)
+        const double DOUBLE_MATH_PI = 3.141592653589793238463;
+        const int STEP = 2;
+        const double length = (double)oversampling * (double)mul;
+        const double c = 0.5 * length - 0.5;
+        const double w = DOUBLE_MATH_PI / (double)oversampling;
+        m_delay = (length - 1.0) / (2.0 * (double)oversampling);
+        int size = STEP * m_in_block;
+        SrcFft fft(size);
+        std::vector<double> re(size, 0.0);
+        std::vector<double> im(size, 0.0);
+        double sum = 0.0;
+        for(int m = 0; m < size; ++m) {
+            double x = (double)m * (double)oversampling / (double)STEP;
+            if(x > length - 1.0) break;
+            double d = x - c;
+            double window = 0.42 - 0.5 * std::cos(2.0 * DOUBLE_MATH_PI * x / (length - 1.0)) +
+                0.08 * std::cos(4.0 * DOUBLE_MATH_PI * x / (length - 1.0));
+            re[m] = (d == 0.0 ? w : std::sin(w * d) / d) * window;
+            sum += re[m];
+        }
+        fft.transform(re, im);
+
+        // частотная характеристика на частотах j / m_in_block, |j| < m_in_block,
+        // с учётом масштаба обратного БПФ. составляющие ниже порога отбрасываются
+        double scale = (double)m_out_block / (double)m_in_block / sum;
+        double threshold = 1.0e-9 * std::fabs(re[0]);
+        int max_bin = 0;
+        for(int j = 1; j < m_in_block; ++j) {
+            if(std::sqrt(re[j] * re[j] + im[j] * im[j]) > threshold ||
+                std::sqrt(re[size - j] * re[size - j] + im[size - j] * im[size - j]) > threshold)
+                max_bin = j;
+        }
+        m_bin_in.clear();
+        m_bin_out.clear();
+        m_fir_re.clear();
+        m_fir_im.clear();
+        for(int j = -max_bin; j <= max_bin; ++j) {
+            int k = j < 0 ? size + j : j;
+            m_bin_in.push_back(((j % m_in_block) + m_in_block) % m_in_block);
+            m_bin_out.push_back(((j % m_out_block) + m_out_block) % m_out_block);
+            m_fir_re.push_back(re[k] * scale);
+            m_fir_im.push_back(im[k] * scale);
+        }
+
+        m_re.assign(m_in_block, 0.0);
+        m_im.assign(m_in_block, 0.0);
+        m_block.resize(m_in_block);
+        m_out_re.resize(m_out_block);
+        m_out_im.resize(m_out_block);
+        reset();
+        return true;
+    }
+
+    /** \brief Включить или выключить TPDF дизеринг выходного сигнала
+     * Имеет смысл только для целого типа выходных сэмплов.
+     * Для независимого дизеринга в разных преобразователях задайте разные seed.
+     * \param is_dither включить дизеринг
+     * \param seed начальное значение генератора, восстанавливается в reset()
+     */
+    void set_dither(bool is_dither, unsigned int seed = SrcSampleFormat<T, TOut>::DEFAULT_SEED) {
+        m_format.set_dither(is_dither, seed);
+    }
+
+    /** \brief Сбросить состояние преобразователя без изменения параметров
+     */
+    void reset() {
+        for(int i = 0; i < m_in_block; ++i) m_block[i] = 0.0;
+        m_block_pos = m_overlap;
+        m_in_count = 0;
+        m_out_count = 0;
+        m_format.reset();
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * Равна задержке SrcFir с теми же параметрами, не учитывает накопление входного блока.
+     * \return задержка в сэмплах входного сигнала
+     */
+    double latency() const {
+        return m_delay;
+    }
+
+    /** \brief Получить задержку выходного сигнала
+     * \return задержка в сэмплах выходного сигнала
+     */
+    double latency_out() const {
+        return latency() * (double)m_up / (double)m_down;
+    }
+
+    /** \brief Преобразовать частоту дискретизации
+     * \param in входной буфер
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int process(std::vector<T> &in, std::vector<TOut> &out) {
+        int outCount = 0;
+        size_t s = 0;
+        while(s < in.size()) {
+            size_t n = (std::min)(in.size() - s, (size_t)(m_in_block - m_block_pos));
+            for(size_t i = 0; i < n; ++i)
+                m_block[m_block_pos + i] = in[s + i];
+            m_block_pos += n;
+            s += n;
+            if(m_block_pos == m_in_block)
+                outCount += process_block(out);
+        }
+        m_in_count += in.size();
+        return outCount;
+    }
+
+    /** \brief Выдать оставшиеся сэмплы
+     * Вход дополняется нулями, пока не будут выданы все сэмплы с учётом задержки,
+     * после чего состояние преобразователя сбрасывается для нового потока.
+     * Количество выходных сэмплов то же, что у SrcFir.
+     * \param out выходной буфер
+     * \return количество сэмплов, добавленных в выходной буфер
+     */
+    int flush(std::vector<TOut> &out) {
+        long long in_count = m_in_count + (long long)std::ceil(latency());
+        long long target = (in_count * m_up + m_down - 1) / m_down;
+        int outCount = 0;
+        std::vector<T> tail(m_in_block - m_overlap, (T)0);
+        while(m_out_count < target)
+            outCount += process(tail, out);
+        // отбрасываем лишние сэмплы последнего блока
+        int excess = (int)(m_out_count - target);
+        out.resize(out.size() - excess);
+        outCount -= excess;
+        reset();
+        return outCount;
+    }
 };
 
 #endif // SAMPLE_RATE_CONVERTER_HPP_INCLUDED